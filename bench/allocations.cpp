@@ -0,0 +1,112 @@
+#include <iostream>
+#include <cmath>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <chrono>
+#include <ComputationalGraph/Graph.hpp>
+#include <ComputationalGraph/FoldNode.hpp>
+
+/**
+ * Counts heap allocations made while the graph is built and while it is run.
+ * Allocations of all threads are counted, including the workers of the pool.
+ */
+
+static std::atomic<size_t> allocationsCount{0};
+
+void* operator new(size_t size)
+{
+    ++allocationsCount;
+    if(void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    ++allocationsCount;
+    size_t align = static_cast<size_t>(alignment);
+    if(void *ptr = std::aligned_alloc(align, (size + align - 1) / align * align))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+
+/**
+ * @brief Builds the graph, runs it many times and prints counts of allocations.
+ * @param arenaSize size of the first block of the graph's arena, 0 to allocate nodes on the heap.
+ */
+void measure(size_t arenaSize)
+{
+    constexpr int width = 64;
+    constexpr int runsCount = 10000;
+
+    size_t before = allocationsCount;
+    ComputationalGraph graph(4, arenaSize);
+    auto &input = graph.addInput<int>();
+    auto &sum = graph.addNode<FoldNode, double, double>(true, [](double x, double y){return x + y;}, 0);
+    for(int i = 0; i < width; ++i)
+    {
+        auto &sqr = graph.addNode<double, int>([i](int x){return x * x + i;}, input);
+        auto &sqrt = graph.addNode<double, double>([](double x){return std::sqrt(x);}, sqr);
+        connect(sqrt, sum);
+    }
+
+    // closures larger than two pointers do not fit into std::function's local storage
+    auto &name = graph.addInput<std::string>();
+    auto &nameLength = graph.addNode<size_t, std::string>([](const std::string &s){return s.size();}, name);
+    double observed = 0, scale = 2, offset = 1;
+    sum.addCallback([&observed, scale, offset](const double &v){observed = v * scale + offset;});
+
+    graph.setInput(input.getId(), 0);
+    graph.setInput(name.getId(), std::string("a name which is longer than the local buffer"));
+    graph.run();
+    size_t buildAllocations = allocationsCount - before;
+
+    before = allocationsCount;
+    auto start = std::chrono::steady_clock::now();
+    double checksum = 0;
+    for(int i = 0; i < runsCount; ++i)
+    {
+        graph.setInput(input.getId(), i);
+        graph.run();
+        checksum += sum.getResult().value() + observed + nameLength.getResult().value();
+    }
+    size_t runAllocations = allocationsCount - before;
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << (arenaSize != 0 ? "arena" : "heap") << "\n"
+              << "nodes: " << 4 + 2 * width << "\n"
+              << "allocations while building and running first time: " << buildAllocations << "\n"
+              << "allocations per run: " << static_cast<double>(runAllocations) / runsCount << "\n"
+              << "microseconds per run: " << elapsed.count() / runsCount << "\n"
+              << "checksum: " << checksum << std::endl;
+}
+
+
+int main()
+{
+    measure(0);
+    measure(64 * 1024);
+    return 0;
+}
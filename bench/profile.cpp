@@ -0,0 +1,63 @@
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <ComputationalGraph/Graph.hpp>
+#include <ComputationalGraph/WorkStealingPool.hpp>
+#include <ComputationalGraph/FoldNode.hpp>
+
+/**
+ * Runs a small wide graph with the profiler enabled (COMPUTATIONALGRAPH_PROFILING),
+ * prints the stats of the last run and writes its Chrome trace to the file given as the argument
+ * (graph.json by default), open it in chrome://tracing or ui.perfetto.dev.
+ */
+
+template <class TExecutor>
+void profile(const char *name, const char *tracePath)
+{
+    ComputationalGraph<TExecutor> graph(4);
+    auto &input = graph.template addInput<int>();
+    auto &sum = graph.template addNode<FoldNode, double, double>(FoldAssociativity::Commutative,
+        [](double acc, double x){return acc + x;}, [](double a, double b){return a + b;}, 0.0);
+    for(int i = 0; i < 64; ++i)
+    {
+        auto &heavy = graph.template addNode<double, int>([i](int x){
+            double acc = 0;
+            for(int k = 0; k < 20000 * (i % 4 + 1); ++k)
+                acc += std::sqrt(double(x + k));
+            return acc;
+        }, input);
+        connect(heavy, sum);
+    }
+
+    for(int run = 0; run < 10; ++run)
+    {
+        graph.setInput(input.getId(), run);
+        graph.run();
+    }
+
+    const RunProfile &last = graph.getProfile();
+    double waited = 0, ran = 0, fanOut = 0;
+    for(const auto &node : last.nodes)
+    {
+        waited += std::chrono::duration<double, std::micro>(node.dequeued - node.ready).count();
+        ran += std::chrono::duration<double, std::micro>(node.end - node.start).count();
+        fanOut += std::chrono::duration<double, std::micro>(node.fanOut).count();
+    }
+    std::cout << name << ": " << last.nodes.size() << " nodes in "
+              << std::chrono::duration<double, std::micro>(last.end - last.begin).count() << " us, "
+              << "run " << ran << " us, waited " << waited << " us, fan out " << fanOut << " us\n";
+    for(size_t i = 0; i < last.workers.size(); ++i)
+        std::cout << "  worker " << i << ": " << last.workers[i].jobsCount << " jobs, "
+                  << last.workers[i].idleCount << " sleeps, " << last.workers[i].stealsCount << " steals\n";
+
+    std::ofstream trace(tracePath);
+    last.writeChromeTrace(trace);
+}
+
+int main(int argc, char **argv)
+{
+    std::string path = argc > 1 ? argv[1] : "graph.json";
+    profile<ThreadsPool<>>("ThreadsPool", path.c_str());
+    profile<WorkStealingPool>("WorkStealingPool", (path + ".stealing.json").c_str());
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <iostream>
+#include <iomanip>
+#include <numeric>
+#include <random>
+#include <chrono>
+#include <ComputationalGraph/WorkStealingPool.hpp>
+#include <ComputationalGraph/Graph.hpp>
+#include <ComputationalGraph/FoldNode.hpp>
+
+/**
+ * Compares built-in reductions of FoldNode with the generic fold through std::function.
+ * Kernels are chosen at compile time, the build enables the instructions of the host CPU if possible.
+ */
+
+template <class F>
+double measure(F &&f, int repeats)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < repeats; ++i)
+        f();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / repeats;
+}
+
+template <typename T>
+void compareKernels(const char *typeName, const std::vector<T> &data)
+{
+    constexpr int repeats = 50;
+    std::function<T(T, T)> sum = [](T a, T b){return a + b;};
+    volatile T sink;
+
+    std::cout << typeName << ", " << data.size() << " elements, ms per array\n" << std::fixed << std::setprecision(3)
+              << "  std::function fold:  " << measure([&]{sink = std::accumulate(data.begin(), data.end(), T(0), sum);}, repeats) << "\n"
+              << "  std::accumulate:     " << measure([&]{sink = std::accumulate(data.begin(), data.end(), T(0));}, repeats) << "\n"
+              << "  Reduction::Sum:      " << measure([&]{sink = Reduction::reduce<Reduction::Sum>(data.data(), data.size(), T(0));}, repeats) << "\n"
+              << "  Reduction::Max:      " << measure([&]{sink = Reduction::reduce<Reduction::Max>(data.data(), data.size(), Reduction::Max::identity<T>());}, repeats) << "\n"
+              << "  Reduction::SumOfSquares: " << measure([&]{sink = Reduction::reduce<Reduction::SumOfSquares>(data.data(), data.size(), T(0));}, repeats) << "\n";
+    (void)sink;
+}
+
+template <class TMakeFold>
+double measureGraph(TMakeFold makeFold, int producersCount, size_t arraySize)
+{
+    constexpr int runsCount = 20;
+
+    ComputationalGraph<WorkStealingPool> graph(4);
+    auto &input = graph.addInput<float>();
+    auto &fold = makeFold(graph);
+    for(int i = 0; i < producersCount; ++i)
+    {
+        auto &producer = graph.addNode<std::vector<float>, float>([arraySize, i](float x){
+            return std::vector<float>(arraySize, x + static_cast<float>(i));
+        }, input);
+        connect(producer, fold);
+    }
+
+    graph.setInput(input.getId(), 1.0f);
+    graph.run();
+    return measure([&]{
+        graph.setInput(input.getId(), 1.0f);
+        graph.run();
+    }, runsCount);
+}
+
+
+int main()
+{
+    constexpr size_t size = 1 << 20;
+    std::mt19937 random(42);
+    std::uniform_real_distribution<double> distribution(-1, 1);
+    std::vector<float> floats(size);
+    std::vector<double> doubles(size);
+    for(size_t i = 0; i < size; ++i)
+        doubles[i] = floats[i] = static_cast<float>(distribution(random));
+
+    compareKernels("float", floats);
+    compareKernels("double", doubles);
+
+    using TGraph = ComputationalGraph<WorkStealingPool>;
+    auto sum = [](float a, float b){return a + b;};
+    std::cout << "graph, 16 producers of " << size << " floats into one FoldNode, ms per run\n"
+              << "  collecting lambda fold:  " << measureGraph([&](TGraph &g) -> FoldNode<float, float>& {
+                     return g.addNode<FoldNode, float, float>(false, sum, 0.0f);}, 16, size) << "\n"
+              << "  commutative lambda fold: " << measureGraph([&](TGraph &g) -> FoldNode<float, float>& {
+                     return g.addNode<FoldNode, float, float>(FoldAssociativity::Commutative, sum, sum, 0.0f);}, 16, size) << "\n"
+              << "  Reduction::Sum:          " << measureGraph([](TGraph &g) -> FoldNode<float, float>& {
+                     return g.addNode<FoldNode, float, float>(Reduction::Sum{});}, 16, size) << std::endl;
+    return 0;
+}
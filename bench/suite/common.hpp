@@ -0,0 +1,37 @@
+#ifndef COMPUTATIONALGRAPH_BENCH_COMMON_HPP
+#define COMPUTATIONALGRAPH_BENCH_COMMON_HPP
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <benchmark/benchmark.h>
+
+
+using BenchClock = std::chrono::steady_clock;
+
+/**
+ * @brief Reports 50th, 90th, 99th percentiles and maximum of the samples in microseconds as counters.
+ * @param state state of the benchmark.
+ * @param samples the samples, they are reordered.
+ * @param prefix prefix of the counters names.
+ */
+inline void reportPercentiles(benchmark::State &state, std::vector<BenchClock::duration> &samples,
+                              const std::string &prefix = "")
+{
+    if(samples.empty())
+        return;
+
+    std::sort(samples.begin(), samples.end());
+    auto at = [&samples](double q){
+        size_t i = std::min(samples.size() - 1, static_cast<size_t>(q * static_cast<double>(samples.size())));
+        return std::chrono::duration<double, std::micro>(samples[i]).count();
+    };
+    state.counters[prefix + "p50_us"] = at(0.5);
+    state.counters[prefix + "p90_us"] = at(0.9);
+    state.counters[prefix + "p99_us"] = at(0.99);
+    state.counters[prefix + "max_us"] = at(1.0);
+}
+
+
+#endif //COMPUTATIONALGRAPH_BENCH_COMMON_HPP
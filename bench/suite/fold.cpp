@@ -0,0 +1,59 @@
+#include <ComputationalGraph/Graph.hpp>
+#include <ComputationalGraph/WorkStealingPool.hpp>
+#include <ComputationalGraph/FoldNode.hpp>
+#include "common.hpp"
+
+/**
+ * Contention of FoldNode: many producers computed in parallel are folded by one node.
+ * The argument is the count of producers.
+ */
+
+namespace
+{
+    enum FoldMode
+    {
+        Collect,
+        InInput,
+        Associative,
+        Commutative
+    };
+
+    template <FoldMode mode, class TGraph>
+    FoldNode<long, long>& addFold(TGraph &graph)
+    {
+        auto fold = [](long acc, long x){return acc + x;};
+        auto combine = [](long a, long b){return a + b;};
+        if constexpr(mode == Collect || mode == InInput)
+            return graph.template addNode<FoldNode, long, long>(mode == InInput, fold, 0L);
+        else
+            return graph.template addNode<FoldNode, long, long>(
+                mode == Associative ? FoldAssociativity::Associative : FoldAssociativity::Commutative, fold, combine, 0L);
+    }
+}
+
+
+template <FoldMode mode>
+void BM_FoldContention(benchmark::State &state)
+{
+    ComputationalGraph<WorkStealingPool> graph(4);
+    auto &input = graph.addInput<int>();
+    auto &sum = addFold<mode>(graph);
+    for(int64_t i = 0; i < state.range(0); ++i)
+    {
+        auto &node = graph.addNode<long, int>([i](int x){return long(x) + i;}, input);
+        connect(node, sum);
+    }
+
+    int value = 0;
+    for(auto _ : state)
+    {
+        graph.setInput(input.getId(), value++);
+        graph.run();
+        benchmark::DoNotOptimize(sum.getResultRef());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_FoldContention, Collect)->Arg(64)->Arg(4096)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FoldContention, InInput)->Arg(64)->Arg(4096)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FoldContention, Associative)->Arg(64)->Arg(4096)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FoldContention, Commutative)->Arg(64)->Arg(4096)->UseRealTime();
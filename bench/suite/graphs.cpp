@@ -0,0 +1,124 @@
+#include <random>
+#include <ComputationalGraph/Graph.hpp>
+#include <ComputationalGraph/WorkStealingPool.hpp>
+#include <ComputationalGraph/FoldNode.hpp>
+#include "common.hpp"
+
+/**
+ * ComputationalGraph::run on typical shapes of graphs, every run recomputes all nodes.
+ * The argument is the count of nodes (approximately for diamonds), graphs are built outside of the measurement.
+ */
+
+namespace
+{
+    constexpr int workersCount = 4;
+    constexpr size_t arenaSize = 1 << 20;
+
+    template <class TGraph, typename T>
+    void runGraph(benchmark::State &state, TGraph &graph, const Node<T> &input, int64_t nodesCount)
+    {
+        T value = 0;
+        for(auto _ : state)
+        {
+            graph.setInput(input.getId(), value++);
+            graph.run();
+        }
+        state.SetItemsProcessed(state.iterations() * nodesCount);
+    }
+}
+
+
+template <class TExecutor>
+void BM_DeepChain(benchmark::State &state)
+{
+    ComputationalGraph<TExecutor> graph(workersCount, arenaSize);
+    Node<int> &input = graph.template addInput<int>();
+    Node<int, int> *last = &graph.template addNode<int, int>([](int x){return x + 1;}, input);
+    for(int64_t i = 1; i < state.range(0); ++i)
+        last = &graph.template addNode<int, int>([](int x){return x + 1;}, *last);
+    runGraph(state, graph, input, state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_DeepChain, ThreadsPool<>)->RangeMultiplier(10)->Range(10, 100000)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_DeepChain, WorkStealingPool)->RangeMultiplier(10)->Range(10, 100000)->UseRealTime();
+
+// input -> width independent nodes -> commutative fold
+template <class TExecutor>
+void BM_FanOutFanIn(benchmark::State &state)
+{
+    ComputationalGraph<TExecutor> graph(workersCount, arenaSize);
+    auto &input = graph.template addInput<int>();
+    auto &sum = graph.template addNode<FoldNode, long, long>(FoldAssociativity::Commutative,
+        [](long acc, long x){return acc + x;}, [](long a, long b){return a + b;}, 0L);
+    for(int64_t i = 0; i < state.range(0); ++i)
+    {
+        auto &node = graph.template addNode<long, int>([i](int x){return long(x) * i;}, input);
+        connect(node, sum);
+    }
+    runGraph(state, graph, input, state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_FanOutFanIn, ThreadsPool<>)->RangeMultiplier(10)->Range(10, 100000)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FanOutFanIn, WorkStealingPool)->RangeMultiplier(10)->Range(10, 100000)->UseRealTime();
+
+// sequence of diamonds: a -> (b, c) -> d, d is a of the next diamond
+template <class TExecutor>
+void BM_Diamonds(benchmark::State &state)
+{
+    ComputationalGraph<TExecutor> graph(workersCount, arenaSize);
+    Node<int> &input = graph.template addInput<int>();
+    Node<int, int> *top = &graph.template addNode<int, int>([](int x){return x;}, input);
+    for(int64_t i = 0; i < state.range(0) / 3; ++i)
+    {
+        auto &left = graph.template addNode<int, int>([](int x){return x + 1;}, *top);
+        auto &right = graph.template addNode<int, int>([](int x){return x - 1;}, *top);
+        auto &bottom = graph.template addNode<int, int, int>([](int a, int b){return (a + b) / 2;}, left, right);
+        top = &graph.template addNode<int, int>([](int x){return x;}, bottom);
+    }
+    runGraph(state, graph, input, state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_Diamonds, ThreadsPool<>)->RangeMultiplier(10)->Range(10, 100000)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Diamonds, WorkStealingPool)->RangeMultiplier(10)->Range(10, 100000)->UseRealTime();
+
+// every node has one or two producers chosen uniformly among the previous nodes, the seed is fixed
+template <class TExecutor>
+void BM_RandomDag(benchmark::State &state)
+{
+    ComputationalGraph<TExecutor> graph(workersCount, arenaSize);
+    std::mt19937 random(42);
+    auto &input = graph.template addInput<long>();
+    std::vector<Node<long, long>*> unary;
+    std::vector<Node<long, long, long>*> binary;
+    // producers are referred by the index of the node: unary ones are even, binary ones are odd
+    std::vector<size_t> nodes;
+    auto addUnary = [&](auto &producer){
+        unary.push_back(&graph.template addNode<long, long>([](long x){return x + 1;}, producer));
+        nodes.push_back(2 * (unary.size() - 1));
+    };
+    auto withProducer = [&](size_t node, auto f){
+        if(node % 2 == 0)
+            f(*unary[node / 2]);
+        else
+            f(*binary[node / 2]);
+    };
+
+    addUnary(input);
+    for(int64_t i = 1; i < state.range(0); ++i)
+    {
+        size_t a = nodes[random() % nodes.size()];
+        if(random() % 2 == 0)
+            withProducer(a, addUnary);
+        else
+        {
+            size_t b = nodes[random() % nodes.size()];
+            withProducer(a, [&](auto &first){
+                withProducer(b, [&](auto &second){
+                    binary.push_back(&graph.template addNode<long, long, long>([](long x, long y){return x ^ y;},
+                                                                                first, second));
+                    nodes.push_back(2 * (binary.size() - 1) + 1);
+                });
+            });
+        }
+    }
+    runGraph(state, graph, input, state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_RandomDag, ThreadsPool<>)->RangeMultiplier(10)->Range(10, 1000000)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_RandomDag, WorkStealingPool)->RangeMultiplier(10)->Range(10, 1000000)->UseRealTime();
@@ -0,0 +1,152 @@
+#include <atomic>
+#include <thread>
+#include <ComputationalGraph/ThreadsPool.hpp>
+#include <ComputationalGraph/WorkStealingPool.hpp>
+#include <ComputationalGraph/DelayQueue.hpp>
+#include "common.hpp"
+
+/**
+ * Throughput and latency of the executors and of DelayQueue.
+ * The argument of pool benchmarks is the count of workers.
+ */
+
+namespace
+{
+    constexpr size_t jobsCount = 10000;
+
+    void waitFor(const std::atomic<size_t> &counter, size_t value)
+    {
+        while(counter.load(std::memory_order_acquire) != value)
+            std::this_thread::yield();
+    }
+}
+
+
+// jobs submitted from outside of the pool, the time includes running all of them
+template <class TPool>
+void BM_PoolSubmitThroughput(benchmark::State &state)
+{
+    TPool pool(static_cast<int>(state.range(0)));
+    std::atomic<size_t> done{0};
+    for(auto _ : state)
+    {
+        done.store(0, std::memory_order_relaxed);
+        for(size_t i = 0; i < jobsCount; ++i)
+            pool.submit([&done]{done.fetch_add(1, std::memory_order_release);});
+        waitFor(done, jobsCount);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * jobsCount));
+}
+BENCHMARK_TEMPLATE(BM_PoolSubmitThroughput, ThreadsPool<>)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_PoolSubmitThroughput, WorkStealingPool)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+// every job submits the next one, as graph nodes schedule their children
+template <class TPool>
+void BM_PoolNestedThroughput(benchmark::State &state)
+{
+    TPool pool(static_cast<int>(state.range(0)));
+    std::atomic<size_t> done{0};
+    std::function<void(size_t)> spawn = [&](size_t depth){
+        if(depth + 1 < jobsCount / 16)
+            pool.submit([&spawn, depth]{spawn(depth + 1);});
+        done.fetch_add(1, std::memory_order_release);
+    };
+    for(auto _ : state)
+    {
+        done.store(0, std::memory_order_relaxed);
+        // 16 independent sequences of nested jobs
+        for(size_t i = 0; i < 16; ++i)
+            pool.submit([&spawn]{spawn(0);});
+        waitFor(done, jobsCount);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * jobsCount));
+}
+BENCHMARK_TEMPLATE(BM_PoolNestedThroughput, ThreadsPool<>)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_PoolNestedThroughput, WorkStealingPool)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+// time from the submission until the job starts, one job at a time
+template <class TPool>
+void BM_PoolLatency(benchmark::State &state)
+{
+    TPool pool(static_cast<int>(state.range(0)));
+    std::vector<BenchClock::duration> samples;
+    std::atomic<size_t> done{0};
+    size_t submitted = 0;
+    for(auto _ : state)
+    {
+        auto submitTime = BenchClock::now();
+        pool.submit([&samples, &done, submitTime]{
+            samples.push_back(BenchClock::now() - submitTime);
+            done.fetch_add(1, std::memory_order_release);
+        });
+        waitFor(done, ++submitted);
+    }
+    reportPercentiles(state, samples);
+}
+BENCHMARK_TEMPLATE(BM_PoolLatency, ThreadsPool<>)->Arg(1)->Arg(4)->Arg(8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_PoolLatency, WorkStealingPool)->Arg(1)->Arg(4)->Arg(8)->UseRealTime();
+
+
+// every benchmark thread pushes and pops, so the benchmark threads contend for the queue
+void BM_DelayQueuePushPop(benchmark::State &state)
+{
+    static DelayQueue<size_t> queue;
+    size_t value = 0;
+    for(auto _ : state)
+    {
+        queue.push(value++, BenchClock::duration::zero());
+        benchmark::DoNotOptimize(queue.pop());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DelayQueuePushPop)->ThreadRange(1, 8)->UseRealTime();
+
+// time from the push until the value is popped by the waiting consumer
+void BM_DelayQueueLatency(benchmark::State &state)
+{
+    DelayQueue<BenchClock::time_point> queue;
+    std::vector<BenchClock::duration> samples;
+    std::atomic<size_t> popped{0};
+    std::atomic<bool> running{true};
+    std::thread consumer([&]{
+        while(running)
+            if(auto pushTime = queue.popWait(std::chrono::milliseconds(1)))
+            {
+                samples.push_back(BenchClock::now() - *pushTime);
+                popped.fetch_add(1, std::memory_order_release);
+            }
+    });
+
+    size_t pushed = 0;
+    for(auto _ : state)
+    {
+        queue.push(BenchClock::now(), BenchClock::duration::zero());
+        waitFor(popped, ++pushed);
+    }
+    running = false;
+    consumer.join();
+    reportPercentiles(state, samples);
+}
+BENCHMARK(BM_DelayQueueLatency)->UseRealTime();
+
+
+// lateness of delayed jobs: how much later than requested they start, the argument is the delay in microseconds
+void BM_SubmitDelayedAccuracy(benchmark::State &state)
+{
+    ThreadsPool<> pool(2);
+    auto delay = std::chrono::microseconds(state.range(0));
+    std::vector<BenchClock::duration> samples;
+    std::atomic<size_t> done{0};
+    size_t submitted = 0;
+    for(auto _ : state)
+    {
+        auto due = BenchClock::now() + delay;
+        pool.submitDelayed([&samples, &done, due]{
+            samples.push_back(BenchClock::now() - due);
+            done.fetch_add(1, std::memory_order_release);
+        }, delay);
+        waitFor(done, ++submitted);
+    }
+    reportPercentiles(state, samples, "late_");
+}
+BENCHMARK(BM_SubmitDelayedAccuracy)->Arg(100)->Arg(1000)->Arg(10000)->Iterations(200)->UseRealTime();
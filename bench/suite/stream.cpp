@@ -0,0 +1,75 @@
+#include <thread>
+#include <ComputationalGraph/Graph.hpp>
+#include <ComputationalGraph/StreamGraph.hpp>
+#include <ComputationalGraph/WorkStealingPool.hpp>
+#include "common.hpp"
+
+/**
+ * A stream of events through a chain of stages: StreamGraph pipelines the events,
+ * ComputationalGraph runs the whole chain for every event. The argument is the cost of a stage
+ * in microseconds (a sleep, like a stage waiting for I/O), 0 measures the overhead per item.
+ */
+
+namespace
+{
+    constexpr int workersCount = 4;
+    constexpr int stagesCount = 4;
+    constexpr int eventsCount = 256;
+
+    void stage(int64_t cost)
+    {
+        if(cost > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(cost));
+    }
+}
+
+
+template <class TExecutor>
+void BM_StreamPipeline(benchmark::State &state)
+{
+    int64_t cost = state.range(0);
+    StreamGraph<TExecutor> graph(workersCount);
+    auto &input = graph.template addInput<int>();
+    StreamOutput<int> *last = &input;
+    for(int i = 0; i < stagesCount; ++i)
+        last = &graph.template addNode<int, int>([cost](int x){stage(cost); return x + 1;}, *last);
+    int64_t sum = 0;
+    last->onOutput([&sum](int x){sum += x;});
+
+    for(auto _ : state)
+    {
+        for(int i = 0; i < eventsCount; ++i)
+            graph.push(input, i);
+        graph.wait();
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * eventsCount);
+}
+BENCHMARK_TEMPLATE(BM_StreamPipeline, ThreadsPool<>)->Arg(0)->Arg(100)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_StreamPipeline, WorkStealingPool)->Arg(0)->Arg(100)->UseRealTime();
+
+template <class TExecutor>
+void BM_RunPerEvent(benchmark::State &state)
+{
+    int64_t cost = state.range(0);
+    ComputationalGraph<TExecutor> graph(workersCount);
+    Node<int> &input = graph.template addInput<int>();
+    Node<int, int> *last = &graph.template addNode<int, int>([cost](int x){stage(cost); return x + 1;}, input);
+    for(int i = 1; i < stagesCount; ++i)
+        last = &graph.template addNode<int, int>([cost](int x){stage(cost); return x + 1;}, *last);
+    int64_t sum = 0;
+
+    for(auto _ : state)
+    {
+        for(int i = 0; i < eventsCount; ++i)
+        {
+            graph.setInput(input.getId(), i);
+            graph.run();
+            sum += *last->getResult();
+        }
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * eventsCount);
+}
+BENCHMARK_TEMPLATE(BM_RunPerEvent, ThreadsPool<>)->Arg(0)->Arg(100)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_RunPerEvent, WorkStealingPool)->Arg(0)->Arg(100)->UseRealTime();
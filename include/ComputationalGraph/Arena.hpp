@@ -0,0 +1,56 @@
+#ifndef COMPUTATIONALGRAPH_ARENA_HPP
+#define COMPUTATIONALGRAPH_ARENA_HPP
+
+#include <memory_resource>
+#include <mutex>
+
+
+/**
+ * @brief Thread safe monotonic memory resource.
+ * Memory is bump-allocated from blocks of growing size and released at once when the arena is destroyed,
+ * deallocate does nothing.
+ */
+class Arena : public std::pmr::memory_resource
+{
+public:
+    /**
+     * @brief Creates empty arena, the first block is allocated on the first allocation.
+     * @param initialSize size of the first block.
+     */
+    explicit Arena(size_t initialSize):
+        resource(initialSize)
+    {}
+
+    /**
+     * @brief Returns count of bytes allocated from the arena.
+     */
+    size_t getAllocatedBytes() const
+    {
+        std::lock_guard lock(arenaMutex);
+        return allocatedBytes;
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        std::lock_guard lock(arenaMutex);
+        allocatedBytes += bytes;
+        return resource.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void*, size_t, size_t) override
+    {}
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+private:
+    std::pmr::monotonic_buffer_resource resource;
+    size_t allocatedBytes = 0;
+    mutable std::mutex arenaMutex;
+};
+
+
+#endif //COMPUTATIONALGRAPH_ARENA_HPP
@@ -0,0 +1,154 @@
+#ifndef COMPUTATIONALGRAPH_ASYNCNODE_HPP
+#define COMPUTATIONALGRAPH_ASYNCNODE_HPP
+
+#include <atomic>
+#include <future>
+#include "Node.hpp"
+#include "Task.hpp"
+
+
+/**
+ * @brief Node whose computation is a coroutine, e.g. waiting for network or disk I/O.
+ * While the coroutine is suspended the worker of ComputationalGraph runs other nodes,
+ * when it completes the rest of the graph is continued by the executor, not by the thread which resumed it.
+ * Outside of ComputationalGraph run() waits for the coroutine.
+ * @code
+ * auto &blob = graph.addNode<AsyncNode, Blob, Key>([&](const Key &key) -> Task<Blob> {
+ *     co_return co_await awaitCallback<Blob>([&](auto resume){client.get(key, std::move(resume));});
+ * }, key);
+ * @endcode
+ * @tparam TOutput type of output of the node.
+ * @tparam TInputs variadic type of input of the node.
+ */
+template <typename TOutput, typename ...TInputs>
+class AsyncNode : public Node<TOutput, TInputs...>
+{
+public:
+    using TNode = Node<TOutput, TInputs...>;
+
+    /**
+     * @brief The computation, the inputs are valid until the task completes.
+     */
+    using TAsyncFunction = std::function<Task<TOutput>(const TInputs& ...)>;
+
+    /**
+     * @brief Creates node with specified computation.
+     * @param id_ Node's id.
+     * @param func the computation func :: TInputs... -> Task<TOutput>.
+     */
+    AsyncNode(size_t id_, const TAsyncFunction &func);
+
+    template<class ...TNodes>
+        requires (sizeof...(TNodes) > 0)
+    AsyncNode(size_t id_, const TAsyncFunction &func, TNodes& ...nodes);
+
+    void setAsyncFunction(const TAsyncFunction &func);
+
+    void run() override;
+
+    bool isParallel() const override
+    {return true;}
+
+    void runParallel(const INode::TSpawn &spawn, INode::TDone done) override;
+
+    void reset() override;
+
+protected:
+    Task<TOutput> startTask();
+
+    void finish();
+
+    enum State
+    {
+        Starting,   // Task::start has not returned yet
+        Suspended,  // the coroutine is suspended, the thread which completes it continues the graph
+        Completed
+    };
+
+    TAsyncFunction asyncFunction;
+    Task<TOutput> task;
+    std::atomic<State> state{Starting};
+    const INode::TSpawn *spawnFunction = nullptr;
+    INode::TDone onDone;
+};
+
+
+
+template<typename TOutput, typename ...TInputs>
+AsyncNode<TOutput, TInputs...>::AsyncNode(size_t id_, const TAsyncFunction &func):
+    TNode(id_),
+    asyncFunction(func)
+{}
+
+template<typename TOutput, typename ...TInputs>
+template<class ...TNodes>
+    requires (sizeof...(TNodes) > 0)
+AsyncNode<TOutput, TInputs...>::AsyncNode(size_t id_, const TAsyncFunction &func, TNodes& ...nodes):
+    AsyncNode(id_, func)
+{
+    TNode::connectAll(nodes...);
+}
+
+template<typename TOutput, typename ...TInputs>
+void AsyncNode<TOutput, TInputs...>::setAsyncFunction(const TAsyncFunction &func)
+{
+    asyncFunction = func;
+}
+
+template<typename TOutput, typename ...TInputs>
+Task<TOutput> AsyncNode<TOutput, TInputs...>::startTask()
+{
+    if(!TNode::isReady())
+        throw std::runtime_error("Some inputs are not initialized");
+    return std::apply([this](TInputs* ...inputs1){return asyncFunction(*inputs1...);}, TNode::inputs);
+}
+
+template<typename TOutput, typename ...TInputs>
+void AsyncNode<TOutput, TInputs...>::run()
+{
+    task = startTask();
+    std::promise<void> completed;
+    task.start([&completed]{completed.set_value();});
+    completed.get_future().wait();
+
+    TNode::result = task.takeResult();
+    TNode::notifyOutputs();
+}
+
+template<typename TOutput, typename ...TInputs>
+void AsyncNode<TOutput, TInputs...>::runParallel(const INode::TSpawn &spawn, INode::TDone done)
+{
+    // the frame of the previous run is destroyed here, after its completion callback returned
+    task = startTask();
+    spawnFunction = &spawn;
+    onDone = std::move(done);
+    state.store(Starting, std::memory_order_relaxed);
+
+    // the coroutine which completes before start returns is finished by this thread without a job
+    task.start([this]{
+        if(state.exchange(Completed, std::memory_order_acq_rel) == Suspended)
+            (*spawnFunction)([this]{finish();});
+    });
+    if(state.exchange(Suspended, std::memory_order_acq_rel) == Completed)
+        finish();
+}
+
+template<typename TOutput, typename ...TInputs>
+void AsyncNode<TOutput, TInputs...>::finish()
+{
+    TNode::result = task.takeResult();
+    TNode::notifyOutputs();
+    // done may start the next run, which replaces onDone
+    INode::TDone done = std::move(onDone);
+    done();
+}
+
+template<typename TOutput, typename ...TInputs>
+void AsyncNode<TOutput, TInputs...>::reset()
+{
+    TNode::reset();
+    task = {};
+}
+
+
+#endif //COMPUTATIONALGRAPH_ASYNCNODE_HPP
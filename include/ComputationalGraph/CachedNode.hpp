@@ -0,0 +1,100 @@
+#ifndef COMPUTATIONALGRAPH_CACHEDNODE_HPP
+#define COMPUTATIONALGRAPH_CACHEDNODE_HPP
+
+#include <memory>
+#include "Node.hpp"
+#include "ResultStore.hpp"
+
+
+/**
+ * @brief Node which persists its results in ResultStore, so they survive restarts and are shared
+ * by the processes of the host. The result is looked up by the key of the node and the hash of its inputs,
+ * the computation is run only if it is not found. The computation must be a pure function,
+ * the key must be the same in every process, be unique among the nodes sharing the store and be changed
+ * with the computation. Ids of nodes are not used as keys, since nodes of other graphs have the same ids.
+ * Unlike MemoNode the inputs are still computed, only the computation of this node is skipped.
+ * @tparam TOutput type of output of the node, must be Serializable.
+ * @tparam TInputs variadic type of input of the node, must be Serializable.
+ */
+template <typename TOutput, typename ...TInputs>
+    requires Serializable<TOutput> && (Serializable<TInputs> && ...)
+class CachedNode : public Node<TOutput, TInputs...>
+{
+public:
+    using TNode = Node<TOutput, TInputs...>;
+    using TFunction = typename TNode::TFunction;
+
+    /**
+     * @brief Creates node with specified computation and store.
+     * @param id_ Node's id.
+     * @param store_ the store.
+     * @param storeKey_ key of the node in the store, e.g. a hash of its name and of the version of its computation.
+     * @param func the computation func :: TInputs... -> TOutput.
+     */
+    CachedNode(size_t id_, std::shared_ptr<ResultStore> store_, uint64_t storeKey_, const TFunction &func);
+
+    template<class ...TNodes>
+        requires (sizeof...(TNodes) > 0)
+    CachedNode(size_t id_, std::shared_ptr<ResultStore> store_, uint64_t storeKey_, const TFunction &func,
+               TNodes& ...nodes);
+
+    /**
+     * @brief Sets the key of the node in the store, see the constructor.
+     */
+    void setStoreKey(uint64_t key)
+    {storeKey = key;}
+
+    uint64_t getStoreKey() const
+    {return storeKey;}
+
+    void run() override;
+
+    std::shared_ptr<ResultStore> getStore() const
+    {return store;}
+
+protected:
+    std::shared_ptr<ResultStore> store;
+    uint64_t storeKey;
+};
+
+
+template<typename TOutput, typename... TInputs>
+    requires Serializable<TOutput> && (Serializable<TInputs> && ...)
+CachedNode<TOutput, TInputs...>::CachedNode(size_t id_, std::shared_ptr<ResultStore> store_, uint64_t storeKey_,
+                                            const TFunction &func):
+    TNode(id_, func),
+    store(std::move(store_)),
+    storeKey(storeKey_)
+{}
+
+template<typename TOutput, typename... TInputs>
+    requires Serializable<TOutput> && (Serializable<TInputs> && ...)
+template<class ...TNodes>
+    requires (sizeof...(TNodes) > 0)
+CachedNode<TOutput, TInputs...>::CachedNode(size_t id_, std::shared_ptr<ResultStore> store_, uint64_t storeKey_,
+                                            const TFunction &func, TNodes& ...nodes):
+    CachedNode(id_, std::move(store_), storeKey_, func)
+{
+    TNode::connectAll(nodes...);
+}
+
+template<typename TOutput, typename... TInputs>
+    requires Serializable<TOutput> && (Serializable<TInputs> && ...)
+void CachedNode<TOutput, TInputs...>::run()
+{
+    if(!TNode::isReady())
+        throw std::runtime_error("Some inputs are not initialized");
+
+    uint64_t inputsHash = std::apply([](TInputs* ...inputs1){return hashValues(*inputs1...);}, TNode::inputs);
+    TNode::result = store->template load<TOutput>(storeKey, inputsHash);
+    if(!TNode::result)
+    {
+        TNode::result = std::apply([this](TInputs* ...inputs1){return TNode::function(*inputs1...);}, TNode::inputs);
+        // the full store leaves the result computed but not persisted
+        store->store(storeKey, inputsHash, *TNode::result);
+    }
+    TNode::notifyOutputs();
+}
+
+
+#endif //COMPUTATIONALGRAPH_CACHEDNODE_HPP
@@ -0,0 +1,189 @@
+#ifndef COMPUTATIONALGRAPH_CHASELEVDEQUE_HPP
+#define COMPUTATIONALGRAPH_CHASELEVDEQUE_HPP
+
+#include <atomic>
+#include <array>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <cstring>
+#include <cstdint>
+
+
+/**
+ * @brief Lock free work stealing deque (Chase, Lev; with memory orders from Le et al.).
+ * Only the owner thread calls push() and take(), any thread may call steal().
+ * @tparam T trivially copyable element type, elements are stored as atomic words,
+ * so a steal racing with the owner never reads a torn value which is then used.
+ */
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+class ChaseLevDeque
+{
+public:
+    explicit ChaseLevDeque(size_t capacity = 1024);
+
+    void push(const T &val);
+
+    std::optional<T> take();
+
+    std::optional<T> steal();
+
+    bool empty() const;
+
+    /**
+     * @brief Returns approximate count of elements.
+     */
+    size_t size() const;
+
+private:
+    static constexpr size_t wordsCount = (sizeof(T) + sizeof(uintptr_t) - 1) / sizeof(uintptr_t);
+
+    struct Slot
+    {
+        std::array<std::atomic<uintptr_t>, wordsCount> words;
+
+        void store(const T &val)
+        {
+            std::array<uintptr_t, wordsCount> raw{};
+            std::memcpy(raw.data(), &val, sizeof(T));
+            for(size_t i = 0; i < wordsCount; ++i)
+                words[i].store(raw[i], std::memory_order_relaxed);
+        }
+
+        T load() const
+        {
+            std::array<uintptr_t, wordsCount> raw;
+            for(size_t i = 0; i < wordsCount; ++i)
+                raw[i] = words[i].load(std::memory_order_relaxed);
+            T val;
+            std::memcpy(static_cast<void*>(&val), raw.data(), sizeof(T));
+            return val;
+        }
+    };
+
+    struct Buffer
+    {
+        explicit Buffer(size_t capacity_):
+            capacity(capacity_), mask(capacity_ - 1), slots(new Slot[capacity_])
+        {}
+
+        Slot& at(int64_t i)
+        {return slots[static_cast<size_t>(i) & mask];}
+
+        size_t capacity;
+        size_t mask;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    Buffer* grow(Buffer *buffer, int64_t top_, int64_t bottom_);
+
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    std::atomic<Buffer*> buffer;
+    // replaced buffers may still be read by thieves, so they live as long as the deque
+    std::vector<std::unique_ptr<Buffer>> buffers;
+};
+
+
+template<typename T>
+    requires std::is_trivially_copyable_v<T>
+ChaseLevDeque<T>::ChaseLevDeque(size_t capacity):
+    top(0),
+    bottom(0)
+{
+    size_t powerOfTwo = 1;
+    while(powerOfTwo < capacity)
+        powerOfTwo <<= 1;
+    buffers.emplace_back(new Buffer(powerOfTwo));
+    buffer = buffers.back().get();
+}
+
+template<typename T>
+    requires std::is_trivially_copyable_v<T>
+void ChaseLevDeque<T>::push(const T &val)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    Buffer *a = buffer.load(std::memory_order_relaxed);
+    if(b - t > static_cast<int64_t>(a->capacity) - 1)
+        a = grow(a, t, b);
+
+    a->at(b).store(val);
+    bottom.store(b + 1, std::memory_order_release);
+}
+
+template<typename T>
+    requires std::is_trivially_copyable_v<T>
+std::optional<T> ChaseLevDeque<T>::take()
+{
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    Buffer *a = buffer.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if(t > b)
+    {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return {};
+    }
+
+    T val = a->at(b).load();
+    if(t == b)
+    {
+        // the last element, race with thieves
+        bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        if(!won)
+            return {};
+    }
+    return val;
+}
+
+template<typename T>
+    requires std::is_trivially_copyable_v<T>
+std::optional<T> ChaseLevDeque<T>::steal()
+{
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if(t >= b)
+        return {};
+
+    Buffer *a = buffer.load(std::memory_order_acquire);
+    T val = a->at(t).load();
+    if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return {};
+    return val;
+}
+
+template<typename T>
+    requires std::is_trivially_copyable_v<T>
+bool ChaseLevDeque<T>::empty() const
+{
+    return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+    requires std::is_trivially_copyable_v<T>
+size_t ChaseLevDeque<T>::size() const
+{
+    int64_t count = bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed);
+    return count > 0 ? static_cast<size_t>(count) : 0;
+}
+
+template<typename T>
+    requires std::is_trivially_copyable_v<T>
+typename ChaseLevDeque<T>::Buffer* ChaseLevDeque<T>::grow(Buffer *a, int64_t top_, int64_t bottom_)
+{
+    auto *bigger = new Buffer(a->capacity * 2);
+    for(int64_t i = top_; i < bottom_; ++i)
+        bigger->at(i).store(a->at(i).load());
+    buffers.emplace_back(bigger);
+    buffer.store(bigger, std::memory_order_release);
+    return bigger;
+}
+
+
+#endif //COMPUTATIONALGRAPH_CHASELEVDEQUE_HPP
@@ -8,7 +8,7 @@
 #include <optional>
 
 
-template <typename T, typename D = std::chrono::system_clock::duration, typename P = std::chrono::system_clock::time_point>
+template <typename T, typename D = std::chrono::steady_clock::duration, typename P = std::chrono::steady_clock::time_point>
 class DelayQueue
 {
 public:
@@ -43,7 +43,7 @@ template<typename T, typename D, typename P>
 template<typename TT>
 void DelayQueue<T, D, P>::push(TT &&val, D delay)
 {
-    auto elem = std::tuple{std::forward<TT>(val), delay, std::chrono::system_clock::now()};
+    auto elem = std::tuple{std::forward<TT>(val), delay, P::clock::now()};
     std::unique_lock lock(queueMutex);
     bool notify = priorityQueue.empty() || compare(priorityQueue.top(), elem);
     priorityQueue.push(elem);
@@ -106,7 +106,7 @@ bool DelayQueue<T, D, P>::compare(const delayedElem &p1, const delayedElem &p2)
 template<typename T, typename D, typename P>
 D DelayQueue<T, D, P>::getDelay(const delayedElem &p)
 {
-    auto now = std::chrono::system_clock::now();
+    auto now = P::clock::now();
     auto duration = std::get<1>(p);
     auto time_point = std::get<2>(p);
 
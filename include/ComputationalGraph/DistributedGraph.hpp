@@ -0,0 +1,438 @@
+#ifndef COMPUTATIONALGRAPH_DISTRIBUTEDGRAPH_HPP
+#define COMPUTATIONALGRAPH_DISTRIBUTEDGRAPH_HPP
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <exception>
+#include "Graph.hpp"
+#include "Partitioner.hpp"
+#include "Transport.hpp"
+
+
+namespace DistributedDetail
+{
+    inline void appendVarint(std::vector<std::byte> &bytes, uint64_t value)
+    {
+        do
+        {
+            auto b = static_cast<std::byte>(value & 0x7f);
+            value >>= 7;
+            bytes.push_back(value != 0 ? b | std::byte{0x80} : b);
+        }
+        while(value != 0);
+    }
+
+    inline bool readVarint(std::span<const std::byte> bytes, size_t &position, uint64_t &value)
+    {
+        value = 0;
+        for(unsigned shift = 0; position < bytes.size() && shift < 64; shift += 7)
+        {
+            auto b = static_cast<uint64_t>(bytes[position++]);
+            value |= (b & 0x7f) << shift;
+            if((b & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+}
+
+
+/**
+ * @brief Runs the parts of one graph on several hosts: every host builds the same graph (the same nodes
+ * in the same order), sets the same inputs and calls run the same number of times, but computes only
+ * the nodes of its part. Results of the nodes read by other hosts are serialized (see Serializer.hpp)
+ * and sent to them by the transport; on the receiving host such producer is completed when its result
+ * arrives, so the graph schedules its consumers as if it was computed there.
+ * Nodes without producers (inputs) are computed by every host. Nodes of other parts which this host does not read
+ * are skipped, their results are not available here.
+ * Results sent to a host are batched: a batch is sent once it exceeds batchBytes or after linger.
+ * Using the graph directly (e.g. ComputationalGraph::run) while it is distributed is not supported.
+ * @code
+ * LoopbackNetwork network(2);  // or TcpTransport transport(rank, {{"10.0.0.1", 7000}, {"10.0.0.2", 7000}});
+ * auto parts = partitionGraph(measuredGraph, 2);
+ * DistributedGraph distributed(graph, network.getTransport(rank), parts);
+ * graph.setInput(input.getId(), x);
+ * distributed.run();
+ * @endcode
+ * @tparam TExecutor executor of the graph, which runs the nodes of this host.
+ */
+template <Executor TExecutor = ThreadsPool<>>
+class DistributedGraph
+{
+public:
+    /**
+     * @brief Bytes of results sent over the cut edge, in the frames of the transport.
+     * Results are sent to a host once however many of its nodes read them,
+     * so edges from one producer to one host report the same bytes.
+     */
+    struct EdgeTraffic
+    {
+        size_t from;
+        size_t to;
+        size_t bytes;
+        size_t messages;
+    };
+
+    /**
+     * @brief Distributes the graph, it must not be running.
+     * @param graph_ the graph with all nodes added.
+     * @param transport_ the transport, this host is transport_.getRank().
+     * @param owners_ host of every node, e.g. by partitionGraph, the same on every host.
+     * @param batchBytes_ size of a batch which is sent without waiting for more results.
+     * @param linger_ how long a batch waits for more results.
+     * @throws std::runtime_error if the result of a node read by another host is not Serializable.
+     */
+    DistributedGraph(ComputationalGraph<TExecutor> &graph_, ITransport &transport_, std::vector<size_t> owners_,
+                     size_t batchBytes_ = 64 << 10, std::chrono::microseconds linger_ = std::chrono::microseconds(50));
+
+    /**
+     * @brief Waits for the run, sends the batched results and returns the graph to the local execution.
+     * Errors of sending them are dropped, since they can not be reported to run.
+     */
+    ~DistributedGraph();
+
+    DistributedGraph(const DistributedGraph&) = delete;
+    DistributedGraph& operator=(const DistributedGraph&) = delete;
+
+    /**
+     * @brief Runs the part of this host and waits until it is computed, including the results it reads
+     * from other hosts. Results read by other hosts may be sent after it returns.
+     * @throws std::runtime_error (or the error of the transport) if sending results failed,
+     * e.g. the connection to a host is lost, during this or a previous run.
+     */
+    void run();
+
+    size_t getOwner(size_t id) const
+    {return owners[id];}
+
+    /**
+     * @brief Checks whether the node is computed by this host.
+     */
+    bool isLocal(size_t id) const
+    {return owners[id] == rank || replicated[id];}
+
+    /**
+     * @brief Returns the traffic of every cut edge from a node of this host.
+     */
+    std::vector<EdgeTraffic> getEdgeTraffic() const;
+
+    size_t getSentBytes() const
+    {return sentBytes;}
+
+    size_t getReceivedBytes() const
+    {return receivedBytes;}
+
+private:
+    struct Export
+    {
+        size_t host;
+        size_t bytes = 0;
+        size_t messages = 0;
+    };
+
+    struct Waiter
+    {
+        uint64_t run = 0;
+        const INode::TSpawn *spawn = nullptr;
+        INode::TDone done;
+    };
+
+    void runExported(size_t id, INode &node, const INode::TSpawn &spawn, INode::TDone done);
+    void runReceived(size_t id, INode &node, const INode::TSpawn &spawn, INode::TDone done);
+    void sendResult(size_t id, const INode &node);
+    void receive(size_t host, std::vector<std::byte> frame);
+    void senderFunction();
+    void rethrowSendError() const;
+
+    ComputationalGraph<TExecutor> &graph;
+    ITransport &transport;
+    size_t rank;
+    std::vector<size_t> owners;
+    std::vector<char> replicated;                  // nodes without producers, computed by every host
+    std::vector<std::vector<Export>> exports;      // hosts reading the result of the node
+    std::vector<std::vector<size_t>> consumers;
+
+    // results received from other hosts
+    uint64_t currentRun = 0;
+    std::vector<Waiter> waiters;                   // node ids, received nodes which are ready to run
+    std::map<std::pair<uint64_t, size_t>, std::vector<std::byte>> arrived;  // results not waited yet
+    std::mutex receiveMutex;
+
+    // batches of results sent to other hosts
+    size_t batchBytes;
+    std::chrono::microseconds linger;
+    std::vector<std::vector<std::byte>> batches;
+    size_t batchedBytes = 0;
+    mutable std::mutex batchMutex;
+    std::condition_variable batchCondition;
+    bool sending = true;
+    std::exception_ptr sendError;                  // the first error of the transport
+    std::thread senderThread;
+
+    std::atomic<size_t> sentBytes{0};
+    std::atomic<size_t> receivedBytes{0};
+};
+
+
+
+template <Executor TExecutor>
+DistributedGraph<TExecutor>::DistributedGraph(ComputationalGraph<TExecutor> &graph_, ITransport &transport_,
+                                              std::vector<size_t> owners_, size_t batchBytes_,
+                                              std::chrono::microseconds linger_):
+    graph(graph_),
+    transport(transport_),
+    rank(transport_.getRank()),
+    owners(std::move(owners_)),
+    batchBytes(batchBytes_),
+    linger(linger_)
+{
+    size_t nodesCount = graph.size();
+    if(owners.size() != nodesCount)
+        throw std::runtime_error("Every node must have an owner");
+    for(size_t owner : owners)
+        if(owner >= transport.getHostsCount())
+            throw std::runtime_error("Owner of a node is not a host");
+
+    replicated.assign(nodesCount, true);
+    consumers.resize(nodesCount);
+    for(size_t id = 0; id < nodesCount; ++id)
+        for(size_t child : graph.getNode(id).getOutputs())
+        {
+            replicated[child] = false;
+            consumers[id].push_back(child);
+        }
+
+    exports.resize(nodesCount);
+    waiters.resize(nodesCount);
+    for(size_t id = 0; id < nodesCount; ++id)
+    {
+        if(replicated[id])
+            continue;
+        INode &node = graph.getNode(id);
+        if(owners[id] == rank)
+        {
+            for(size_t child : consumers[id])
+                if(owners[child] != rank && std::none_of(exports[id].begin(), exports[id].end(),
+                                                         [&](const Export &e){return e.host == owners[child];}))
+                    exports[id].push_back({owners[child]});
+            if(exports[id].empty())
+                continue;
+            if(!node.isResultSerializable())
+                throw std::runtime_error("Result of node " + std::to_string(id) + " is read by another host, "
+                                         "but it is not serializable");
+            graph.setNodeRunner(id, [this, id](INode &n, const INode::TSpawn &spawn, INode::TDone done){
+                runExported(id, n, spawn, std::move(done));
+            });
+        }
+        else if(std::any_of(consumers[id].begin(), consumers[id].end(), [&](size_t child){return owners[child] == rank;}))
+        {
+            if(!node.isResultSerializable())
+                throw std::runtime_error("Result of node " + std::to_string(id) + " is read by another host, "
+                                         "but it is not serializable");
+            graph.setNodeRunner(id, [this, id](INode &n, const INode::TSpawn &spawn, INode::TDone done){
+                runReceived(id, n, spawn, std::move(done));
+            });
+        }
+        else
+            // neither computed nor read here, so its consumers are skipped as well
+            graph.setNodeRunner(id, [](INode&, const INode::TSpawn&, INode::TDone done){done();});
+    }
+
+    batches.resize(transport.getHostsCount());
+    senderThread = std::thread(&DistributedGraph::senderFunction, this);
+    transport.setReceiver([this](size_t host, std::vector<std::byte> frame){
+        receive(host, std::move(frame));
+    });
+}
+
+template <Executor TExecutor>
+DistributedGraph<TExecutor>::~DistributedGraph()
+{
+    graph.wait();
+    transport.setReceiver(nullptr);
+    for(size_t id = 0; id < graph.size(); ++id)
+        graph.setNodeRunner(id, nullptr);
+
+    {
+        std::lock_guard lock(batchMutex);
+        sending = false;
+    }
+    batchCondition.notify_one();
+    senderThread.join();
+}
+
+template <Executor TExecutor>
+void DistributedGraph<TExecutor>::run()
+{
+    {
+        std::lock_guard lock(receiveMutex);
+        ++currentRun;
+        // results of the runs which skipped the node are never waited
+        while(!arrived.empty() && arrived.begin()->first.first < currentRun)
+            arrived.erase(arrived.begin());
+    }
+    rethrowSendError();
+    graph.run();
+    rethrowSendError();
+}
+
+template <Executor TExecutor>
+void DistributedGraph<TExecutor>::runExported(size_t id, INode &node, const INode::TSpawn &spawn, INode::TDone done)
+{
+    if(node.isParallel())
+        node.runParallel(spawn, [this, id, &node, done]{
+            sendResult(id, node);
+            done();
+        });
+    else
+    {
+        node.run();
+        sendResult(id, node);
+        done();
+    }
+}
+
+template <Executor TExecutor>
+void DistributedGraph<TExecutor>::runReceived(size_t id, INode &node, const INode::TSpawn &spawn, INode::TDone done)
+{
+    std::unique_lock lock(receiveMutex);
+    auto it = arrived.find({currentRun, id});
+    if(it == arrived.end())
+    {
+        // completed by the thread which receives the result
+        waiters[id] = {currentRun, &spawn, std::move(done)};
+        return;
+    }
+    std::vector<std::byte> bytes = std::move(it->second);
+    arrived.erase(it);
+    lock.unlock();
+
+    node.deserializeResult(bytes);
+    done();
+}
+
+template <Executor TExecutor>
+void DistributedGraph<TExecutor>::sendResult(size_t id, const INode &node)
+{
+    // the record is the run, the node, the size and the serialized result
+    thread_local std::vector<std::byte> result;
+    result.clear();
+    node.serializeResult(result);
+
+    {
+        std::lock_guard lock(batchMutex);
+        for(Export &e : exports[id])
+        {
+            std::vector<std::byte> &batch = batches[e.host];
+            size_t batchSize = batch.size();
+            DistributedDetail::appendVarint(batch, currentRun);
+            DistributedDetail::appendVarint(batch, id);
+            DistributedDetail::appendVarint(batch, result.size());
+            batch.insert(batch.end(), result.begin(), result.end());
+            e.bytes += batch.size() - batchSize;
+            ++e.messages;
+            batchedBytes += batch.size() - batchSize;
+        }
+    }
+    // the sender starts the linger or sends the full batches
+    batchCondition.notify_one();
+}
+
+template <Executor TExecutor>
+void DistributedGraph<TExecutor>::senderFunction()
+{
+    std::unique_lock lock(batchMutex);
+    for(;;)
+    {
+        batchCondition.wait(lock, [this]{return !sending || batchedBytes > 0;});
+        if(sending && batchedBytes < batchBytes)
+            batchCondition.wait_for(lock, linger, [this]{return !sending || batchedBytes >= batchBytes;});
+        if(batchedBytes == 0 && !sending)
+            return;
+
+        std::vector<std::vector<std::byte>> ready(batches.size());
+        ready.swap(batches);
+        batches.resize(ready.size());
+        batchedBytes = 0;
+        lock.unlock();
+        // an exception leaving the thread would terminate the process, so it is passed to run
+        std::exception_ptr error;
+        for(size_t host = 0; host < ready.size(); ++host)
+            if(!ready[host].empty())
+                try
+                {
+                    sentBytes += ready[host].size();
+                    transport.send(host, std::move(ready[host]));
+                }
+                catch(...)
+                {
+                    if(!error)
+                        error = std::current_exception();
+                }
+        lock.lock();
+        if(error && !sendError)
+            sendError = error;
+    }
+}
+
+template <Executor TExecutor>
+void DistributedGraph<TExecutor>::rethrowSendError() const
+{
+    std::lock_guard lock(batchMutex);
+    if(sendError)
+        std::rethrow_exception(sendError);
+}
+
+template <Executor TExecutor>
+void DistributedGraph<TExecutor>::receive(size_t host, std::vector<std::byte> frame)
+{
+    (void)host;
+    receivedBytes += frame.size();
+    std::span<const std::byte> bytes(frame);
+    size_t position = 0;
+    while(position < bytes.size())
+    {
+        uint64_t run, id, size;
+        if(!DistributedDetail::readVarint(bytes, position, run) || !DistributedDetail::readVarint(bytes, position, id) ||
+           !DistributedDetail::readVarint(bytes, position, size) || id >= waiters.size() || size > bytes.size() - position)
+            return;
+        std::vector<std::byte> result(bytes.begin() + position, bytes.begin() + position + size);
+        position += size;
+
+        std::unique_lock lock(receiveMutex);
+        Waiter &waiter = waiters[id];
+        if(!waiter.done || waiter.run != run)
+        {
+            arrived[{run, id}] = std::move(result);
+            continue;
+        }
+        Waiter ready = std::move(waiter);
+        waiter = {};
+        lock.unlock();
+
+        // the graph is continued by the executor, not by the thread of the transport
+        INode &node = graph.getNode(id);
+        (*ready.spawn)([&node, result = std::move(result), done = std::move(ready.done)]{
+            node.deserializeResult(result);
+            done();
+        });
+    }
+}
+
+template <Executor TExecutor>
+std::vector<typename DistributedGraph<TExecutor>::EdgeTraffic> DistributedGraph<TExecutor>::getEdgeTraffic() const
+{
+    std::vector<EdgeTraffic> traffic;
+    std::lock_guard lock(batchMutex);
+    for(size_t id = 0; id < exports.size(); ++id)
+        for(const Export &e : exports[id])
+            for(size_t child : consumers[id])
+                if(owners[child] == e.host)
+                    traffic.push_back({id, child, e.bytes, e.messages});
+    return traffic;
+}
+
+
+#endif //COMPUTATIONALGRAPH_DISTRIBUTEDGRAPH_HPP
@@ -0,0 +1,88 @@
+#ifndef COMPUTATIONALGRAPH_EVENTCOUNT_HPP
+#define COMPUTATIONALGRAPH_EVENTCOUNT_HPP
+
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+
+/**
+ * @brief Hints the processor that the thread is spinning.
+ */
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+
+/**
+ * @brief Lets idle threads sleep on std::atomic::wait until something is published.
+ * Waiter: key = prepareWait(); check the condition again; then cancelWait() or wait(key).
+ * Notifier: publish; notifyOne(). Nothing is lost between the check and the wait,
+ * since the notification changes the epoch which the waiter sleeps on.
+ * Until the woken thread runs, the following notifications are skipped: it is expected to
+ * take the published work and call notifyOne() itself if there is more.
+ */
+class EventCount
+{
+public:
+    uint32_t prepareWait()
+    {
+        waitersCount.fetch_add(1, std::memory_order_seq_cst);
+        wakePending.store(false, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return epoch.load(std::memory_order_seq_cst);
+    }
+
+    void cancelWait()
+    {
+        waitersCount.fetch_sub(1, std::memory_order_seq_cst);
+        wakePending.store(false, std::memory_order_seq_cst);
+    }
+
+    void wait(uint32_t key)
+    {
+        epoch.wait(key, std::memory_order_seq_cst);
+        waitersCount.fetch_sub(1, std::memory_order_seq_cst);
+        wakePending.store(false, std::memory_order_seq_cst);
+    }
+
+    /**
+     * @brief Wakes one waiter. Costs a fence and a load when nobody waits.
+     * @return false if nobody waits, true if a waiter is woken (by this or by the previous call).
+     */
+    bool notifyOne()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(waitersCount.load(std::memory_order_seq_cst) == 0)
+            return false;
+        if(wakePending.exchange(true, std::memory_order_seq_cst))
+            return true;
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        epoch.notify_one();
+        return true;
+    }
+
+    void notifyAll()
+    {
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        epoch.notify_all();
+    }
+
+private:
+    std::atomic<uint32_t> epoch{0};
+    std::atomic<int> waitersCount{0};
+    std::atomic<bool> wakePending{false};
+};
+
+
+#endif //COMPUTATIONALGRAPH_EVENTCOUNT_HPP
@@ -0,0 +1,19 @@
+#ifndef COMPUTATIONALGRAPH_EXECUTOR_HPP
+#define COMPUTATIONALGRAPH_EXECUTOR_HPP
+
+#include <functional>
+#include <concepts>
+
+
+/**
+ * @brief Requirements to the executor of ComputationalGraph (e.g. ThreadsPool or WorkStealingPool).
+ * Executor runs submitted jobs asynchronously, jobs may submit other jobs.
+ */
+template <typename T>
+concept Executor = requires(T &executor, std::function<void()> job)
+{
+    executor.submit(std::move(job));
+};
+
+
+#endif //COMPUTATIONALGRAPH_EXECUTOR_HPP
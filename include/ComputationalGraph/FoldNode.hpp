@@ -1,7 +1,25 @@
 #ifndef COMPUTATIONALGRAPH_FOLDNODE_HPP
 #define COMPUTATIONALGRAPH_FOLDNODE_HPP
 
+#include <mutex>
+#include <bit>
+#include <thread>
 #include "Node.hpp"
+#include "Reductions.hpp"
+
+
+/**
+ * @brief Properties of the fold which allow FoldNode to compute it in parallel.
+ * Associative: partial results of adjacent inputs may be combined in any grouping,
+ * inputs are reduced by the pairwise tree in the order of connections.
+ * Commutative: partial results may also be combined in any order,
+ * every thread accumulates the inputs it produced into its own partial result.
+ */
+enum class FoldAssociativity
+{
+    Associative,
+    Commutative
+};
 
 
 template <typename TOutput, typename TInput>
@@ -9,6 +27,7 @@ class FoldNode : public Node<TOutput, std::vector<TInput>>
 {
 public:
     using TFunction = std::function<TOutput(TOutput, TInput)>;
+    using TCombineFunction = std::function<TOutput(TOutput, TOutput)>;
     using TLInput = std::vector<TInput>;
     using TNode = Node<TOutput, TLInput>;
 
@@ -19,48 +38,160 @@ public:
     template<class ...TNodes>
     FoldNode(size_t id_, bool computeWithInput, const TFunction &func, TOutput init, TNodes& ...nodes);
 
+    /**
+     * @brief Creates node computing the fold in parallel, without locks on the inputs.
+     * @param id_ Node's id.
+     * @param associativity declared properties of the fold.
+     * @param func the fold func :: (TOutput, TInput) -> TOutput.
+     * @param combine the func combining partial results :: (TOutput, TOutput) -> TOutput.
+     * @param identity the identity element: combine(identity, x) == combine(x, identity) == x.
+     */
+    FoldNode(size_t id_, FoldAssociativity associativity, const TFunction &func, const TCombineFunction &combine, TOutput identity);
+
+    template<class ...TNodes>
+    FoldNode(size_t id_, FoldAssociativity associativity, const TFunction &func, const TCombineFunction &combine,
+             TOutput identity, TNodes& ...nodes);
+
+    /**
+     * @brief Creates node computing the built-in reduction (e.g. Reduction::Sum) as the commutative fold.
+     * Arrays from producers of std::vector<TInput> are reduced by vectorized kernels.
+     * @tparam TReduction the reduction.
+     * @param id_ Node's id.
+     * @param nodes sequence of input Nodes.
+     */
+    template<class TReduction, class ...TNodes>
+        requires BuiltinReduction<TReduction, TInput> && std::same_as<TOutput, TInput>
+    FoldNode(size_t id_, TReduction, TNodes& ...nodes);
+
     bool isReady() const override;
 
     void run() override;
 
+    void reset() override;
+
+    void setMemoryResource(std::pmr::memory_resource *resource) override;
+
     template<typename ...TInputs1>
     void connectFrom(Node<TInput, TInputs1...> &node);
 
     template<typename ...TInputs1>
     void connectFrom(Node<std::vector<TInput>, TInputs1...> &node);
 
+    /**
+     * @brief Adds the input.
+     * @throws std::runtime_error for the associative fold, since its inputs are ordered by connections.
+     * @param input the input.
+     */
     virtual void add(const TInput &input);
 
+    /**
+     * @brief Adds the input, it is moved if the inputs are collected for the computation.
+     * @param input the input.
+     */
+    virtual void add(TInput &&input);
+
     virtual std::optional<TOutput> getResult() const;
 
 protected:
+    enum class Mode
+    {
+        Collect,    // inputs are collected and folded by run
+        InInput,    // inputs are folded into currentValue by the producers
+        Tree,       // associative fold, pairwise tree over the connections
+        Striped     // commutative fold, partial result per thread
+    };
+
+    // trivially copyable values are updated with CAS, others under addMutex
+    static constexpr bool lockFreeValue = []{
+        if constexpr(std::is_trivially_copyable_v<TOutput>)
+            return std::atomic<TOutput>::is_always_lock_free;
+        else
+            return false;
+    }();
+    using TValue = std::conditional_t<lockFreeValue, std::atomic<TOutput>, TOutput>;
+
+    struct alignas(64) Stripe
+    {
+        std::mutex stripeMutex;
+        std::optional<TOutput> value;
+    };
+
+    /**
+     * @brief Rebuilds the reduction tree for the current count of connections.
+     */
+    void buildTree();
+
+    /**
+     * @brief Stores the partial result of the connection and combines it with its neighbours
+     * up the tree while they are ready. The last arrived subtree of every pair combines the pair.
+     */
+    void arrive(size_t connection, TOutput &&partial);
+
+    /**
+     * @brief Combines the partial result with the partial result of the current thread.
+     */
+    void addPartial(TOutput &&partial);
+
+    /**
+     * @brief Folds the array, starting from initValue.
+     */
+    TOutput foldArray(const std::vector<TInput> &array);
+
+    static size_t threadIndex();
+
     TFunction foldFunction;
-    bool computeInInputNode;
+    TCombineFunction combineFunction;
+    Mode mode;
     std::atomic<int> inputsReadyCount;
     int inputsDeclaredCount;
-    std::atomic<TOutput> currentValue;
+    TValue currentValue;
+    TOutput initValue;
 
+    // inputs collected for the computation when it is not computed in input nodes,
+    // they are read only by run, so they are kept in the memory resource of the graph
+    std::pmr::vector<TInput> values;
     std::mutex addMutex;
+
+    // pairwise tree in the heap layout: node k has children 2k and 2k + 1, leaves start at treeLeaves
+    size_t treeLeaves = 0;
+    std::vector<std::optional<TOutput>> treeValues;
+    std::vector<int> treeInitialArrivals;  // count of children without connections
+    std::unique_ptr<std::atomic<int>[]> treeArrivals;
+
+    size_t stripesCount = 0;
+    std::unique_ptr<Stripe[]> stripes;
+
+    // vectorized kernel of the built-in reduction
+    TOutput (*reduceArray)(const TInput *data, size_t size, TOutput init) = nullptr;
 };
 
 template<typename TOutput, typename TInput>
 FoldNode<TOutput, TInput>::FoldNode(size_t id_, bool computeWithInput):
     TNode(id_),
-    computeInInputNode(computeWithInput),
+    mode(computeWithInput ? Mode::InInput : Mode::Collect),
     inputsReadyCount(0),
-    inputsDeclaredCount(0)
-{
-    if(!computeInInputNode)
-        std::get<0>(TNode::inputs) = new std::vector<TInput>;
-}
+    inputsDeclaredCount(0),
+    initValue{}
+{}
 
 template<typename TOutput, typename TInput>
 FoldNode<TOutput, TInput>::FoldNode(FoldNode &&node) noexcept:
     TNode(std::move(node)),
-    computeInInputNode(node.computeInInputNode),
-    inputsReadyCount(node.inputsReadyCount),
+    foldFunction(std::move(node.foldFunction)),
+    combineFunction(std::move(node.combineFunction)),
+    mode(node.mode),
+    inputsReadyCount(node.inputsReadyCount.load()),
     inputsDeclaredCount(node.inputsDeclaredCount),
-    currentValue(std::move(node.currentValue))
+    currentValue(static_cast<const TOutput&>(node.currentValue)),
+    initValue(std::move(node.initValue)),
+    values(std::move(node.values)),
+    treeLeaves(node.treeLeaves),
+    treeValues(std::move(node.treeValues)),
+    treeInitialArrivals(std::move(node.treeInitialArrivals)),
+    treeArrivals(std::move(node.treeArrivals)),
+    stripesCount(node.stripesCount),
+    stripes(std::move(node.stripes)),
+    reduceArray(node.reduceArray)
 {}
 
 template<typename TOutput, typename TInput>
@@ -68,13 +199,9 @@ FoldNode<TOutput, TInput>::FoldNode(size_t id_, bool computeWithInput, const Fol
     FoldNode(id_, computeWithInput)
 {
     foldFunction = func;
-    TNode::inputsSet[0] = true;
+    initValue = init;
     if(computeWithInput)
         currentValue = init;
-    else
-        TNode::setFunction([init, func](const TLInput &inputs){
-            return std::accumulate(inputs.begin(), inputs.end(), init, func);
-        });
 }
 
 template<typename TOutput, typename TInput>
@@ -85,6 +212,46 @@ FoldNode<TOutput, TInput>::FoldNode(size_t id_, bool computeWithInput, const TFu
     (connect(nodes, *this) , ...);
 }
 
+template<typename TOutput, typename TInput>
+FoldNode<TOutput, TInput>::FoldNode(size_t id_, FoldAssociativity associativity, const TFunction &func,
+                                    const TCombineFunction &combine, TOutput identity):
+    TNode(id_),
+    foldFunction(func),
+    combineFunction(combine),
+    mode(associativity == FoldAssociativity::Associative ? Mode::Tree : Mode::Striped),
+    inputsReadyCount(0),
+    inputsDeclaredCount(0),
+    initValue(std::move(identity))
+{
+    if(mode == Mode::Tree)
+        buildTree();
+    else
+    {
+        stripesCount = std::bit_ceil(std::max(1u, std::thread::hardware_concurrency()));
+        stripes.reset(new Stripe[stripesCount]);
+    }
+}
+
+template<typename TOutput, typename TInput>
+template<class ...TNodes>
+FoldNode<TOutput, TInput>::FoldNode(size_t id_, FoldAssociativity associativity, const TFunction &func,
+                                    const TCombineFunction &combine, TOutput identity, TNodes& ...nodes):
+    FoldNode(id_, associativity, func, combine, std::move(identity))
+{
+    (connect(nodes, *this) , ...);
+}
+
+template<typename TOutput, typename TInput>
+template<class TReduction, class ...TNodes>
+    requires BuiltinReduction<TReduction, TInput> && std::same_as<TOutput, TInput>
+FoldNode<TOutput, TInput>::FoldNode(size_t id_, TReduction, TNodes& ...nodes):
+    FoldNode(id_, FoldAssociativity::Commutative, &TReduction::template accumulate<TInput>,
+             &TReduction::template combine<TInput>, TReduction::template identity<TInput>())
+{
+    reduceArray = &Reduction::reduce<TReduction, TInput>;
+    (connect(nodes, *this) , ...);
+}
+
 template<typename TOutput, typename TInput>
 bool FoldNode<TOutput, TInput>::isReady() const
 {
@@ -94,48 +261,226 @@ bool FoldNode<TOutput, TInput>::isReady() const
 template<typename TOutput, typename TInput>
 void FoldNode<TOutput, TInput>::run()
 {
-    if(!computeInInputNode)
-        TNode::run();
-    else
+    switch(mode)
+    {
+    case Mode::Collect:
+    {
+        // collected values belong to the node, so they are moved into the fold instead of being copied
+        TOutput accumulator = initValue;
+        for(auto &v : values)
+            accumulator = foldFunction(std::move(accumulator), std::move(v));
+        TNode::result = std::move(accumulator);
+        break;
+    }
+    case Mode::InInput:
+        TNode::result = static_cast<const TOutput&>(currentValue);
+        break;
+    case Mode::Tree:
+        // the root is combined by the last arrived connection
+        TNode::result = treeValues[1] ? std::move(*treeValues[1]) : initValue;
+        break;
+    case Mode::Striped:
+    {
+        TOutput accumulator = initValue;
+        for(size_t i = 0; i < stripesCount; ++i)
+            if(stripes[i].value)
+                accumulator = combineFunction(std::move(accumulator), std::move(*stripes[i].value));
+        TNode::result = std::move(accumulator);
+        break;
+    }
+    }
+    TNode::notifyOutputs();
+}
+
+template<typename TOutput, typename TInput>
+void FoldNode<TOutput, TInput>::reset()
+{
+    TNode::result.reset();
+    TNode::resultReleased = false;
+    inputsReadyCount = 0;
+    switch(mode)
     {
-        TNode::result = currentValue;
-        std::for_each(TNode::outputCallbacks.begin(), TNode::outputCallbacks.end(), [this](auto callback){callback(*TNode::result);});
+    case Mode::Collect:
+        values.clear();
+        break;
+    case Mode::InInput:
+        currentValue = initValue;
+        break;
+    case Mode::Tree:
+        for(auto &v : treeValues)
+            v.reset();
+        for(size_t k = 1; k < treeLeaves; ++k)
+            treeArrivals[k].store(treeInitialArrivals[k], std::memory_order_relaxed);
+        break;
+    case Mode::Striped:
+        for(size_t i = 0; i < stripesCount; ++i)
+            stripes[i].value.reset();
+        break;
     }
 }
 
+template<typename TOutput, typename TInput>
+void FoldNode<TOutput, TInput>::setMemoryResource(std::pmr::memory_resource *resource)
+{
+    TNode::setMemoryResource(resource);
+    TNode::rebind(values, resource);
+}
+
 template<typename TOutput, typename TInput>
 void FoldNode<TOutput, TInput>::add(const TInput &input)
 {
-    if(computeInInputNode)
+    switch(mode)
+    {
+    case Mode::Collect:
     {
-        TOutput copy = currentValue;
-        while(!currentValue.compare_exchange_weak(copy, foldFunction(copy, input)))
-            copy = currentValue;
+        std::lock_guard lock(addMutex);
+        values.emplace_back(input);
+        break;
     }
-    else
+    case Mode::InInput:
+        if constexpr(lockFreeValue)
+        {
+            TOutput copy = currentValue;
+            while(!currentValue.compare_exchange_weak(copy, foldFunction(copy, input)))
+                copy = currentValue;
+        }
+        else
+        {
+            std::lock_guard lock(addMutex);
+            currentValue = foldFunction(std::move(currentValue), input);
+        }
+        break;
+    case Mode::Tree:
+        throw std::runtime_error("Inputs of the associative fold are ordered by connections");
+    case Mode::Striped:
+    {
+        // threads are spread over the stripes, so the lock is almost never contended
+        Stripe &stripe = stripes[threadIndex() & (stripesCount - 1)];
+        std::lock_guard lock(stripe.stripeMutex);
+        stripe.value = foldFunction(stripe.value ? std::move(*stripe.value) : initValue, input);
+        break;
+    }
+    }
+}
+
+template<typename TOutput, typename TInput>
+void FoldNode<TOutput, TInput>::addPartial(TOutput &&partial)
+{
+    Stripe &stripe = stripes[threadIndex() & (stripesCount - 1)];
+    std::lock_guard lock(stripe.stripeMutex);
+    stripe.value = stripe.value ? combineFunction(std::move(*stripe.value), std::move(partial)) : std::move(partial);
+}
+
+template<typename TOutput, typename TInput>
+TOutput FoldNode<TOutput, TInput>::foldArray(const std::vector<TInput> &array)
+{
+    // std::vector<bool> has no contiguous storage, while bool is not reduced by the kernels anyway
+    if constexpr(!std::is_same_v<TInput, bool>)
+        if(reduceArray)
+            return reduceArray(array.data(), array.size(), initValue);
+
+    TOutput partial = initValue;
+    for(const auto &v : array)
+        partial = foldFunction(std::move(partial), v);
+    return partial;
+}
+
+template<typename TOutput, typename TInput>
+void FoldNode<TOutput, TInput>::add(TInput &&input)
+{
+    if(mode == Mode::Collect)
     {
         std::lock_guard lock(addMutex);
-        std::get<0>(TNode::inputs)->emplace_back(input);
+        values.emplace_back(std::move(input));
+    }
+    else
+        add(static_cast<const TInput&>(input));
+}
+
+template<typename TOutput, typename TInput>
+void FoldNode<TOutput, TInput>::buildTree()
+{
+    treeLeaves = std::bit_ceil(std::max<size_t>(inputsDeclaredCount, 1));
+    treeValues.assign(2 * treeLeaves, std::nullopt);
+
+    // a subtree exists if it has a connection, the missing child of a pair counts as arrived
+    std::vector<char> exists(2 * treeLeaves, false);
+    for(size_t i = 0; i < static_cast<size_t>(inputsDeclaredCount); ++i)
+        exists[treeLeaves + i] = true;
+    treeInitialArrivals.assign(treeLeaves, 0);
+    for(size_t k = treeLeaves; k-- > 1;)
+    {
+        exists[k] = exists[2 * k] || exists[2 * k + 1];
+        treeInitialArrivals[k] = !exists[2 * k] + !exists[2 * k + 1];
+    }
+
+    treeArrivals.reset(new std::atomic<int>[treeLeaves]);
+    for(size_t k = 1; k < treeLeaves; ++k)
+        treeArrivals[k] = treeInitialArrivals[k];
+}
+
+template<typename TOutput, typename TInput>
+void FoldNode<TOutput, TInput>::arrive(size_t connection, TOutput &&partial)
+{
+    size_t k = treeLeaves + connection;
+    treeValues[k] = std::move(partial);
+    for(; k > 1; k /= 2)
+    {
+        size_t parent = k / 2;
+        // the first arrived child leaves, the second one sees its value and combines the pair
+        if(treeArrivals[parent].fetch_add(1, std::memory_order_acq_rel) == 0)
+            return;
+
+        auto &left = treeValues[2 * parent], &right = treeValues[2 * parent + 1];
+        if(left && right)
+            treeValues[parent] = combineFunction(std::move(*left), std::move(*right));
+        else
+            treeValues[parent] = std::move(left ? *left : *right);
     }
 }
 
+template<typename TOutput, typename TInput>
+size_t FoldNode<TOutput, TInput>::threadIndex()
+{
+    static std::atomic<size_t> nextIndex{0};
+    thread_local size_t index = nextIndex++;
+    return index;
+}
+
 
 template<typename TOutput, typename TInput>
 template<typename... TInputs1>
 void FoldNode<TOutput, TInput>::connectFrom(Node<TInput, TInputs1...> &node)
 {
+    if(mode == Mode::Tree)
+    {
+        size_t connection = inputsDeclaredCount++;
+        buildTree();
+        node.addCallback([this, connection](const TInput &output){
+            arrive(connection, foldFunction(initValue, output));
+            ++inputsReadyCount;
+        }, TNode::getId(), [this, connection](TInput &&output){
+            arrive(connection, foldFunction(initValue, std::move(output)));
+            ++inputsReadyCount;
+        });
+        return;
+    }
+
     ++inputsDeclaredCount;
     node.addCallback([this](const TInput &output){
         add(output);
         ++inputsReadyCount;
-    }, TNode::getId());
+    }, TNode::getId(), [this](TInput &&output){
+        add(std::move(output));
+        ++inputsReadyCount;
+    });
 }
 
 template<typename TOutput, typename TInput>
 std::optional<TOutput> FoldNode<TOutput, TInput>::getResult() const
 {
-    if(computeInInputNode)
-        return currentValue;
+    if(mode == Mode::InInput)
+        return static_cast<const TOutput&>(currentValue);
     else
         return TNode::result;
 }
@@ -144,19 +489,51 @@ template<typename TOutput, typename TInput>
 template<typename... TInputs1>
 void FoldNode<TOutput, TInput>::connectFrom(Node<std::vector<TInput>, TInputs1...> &node)
 {
+    if(mode == Mode::Tree)
+    {
+        // elements of one producer are folded sequentially into its leaf
+        size_t connection = inputsDeclaredCount++;
+        buildTree();
+        node.addCallback([this, connection](const std::vector<TInput> &output){
+            arrive(connection, foldArray(output));
+            ++inputsReadyCount;
+        }, TNode::getId(), [this, connection](std::vector<TInput> &&output){
+            TOutput partial = initValue;
+            for(auto &v : output)
+                partial = foldFunction(std::move(partial), std::move(v));
+            arrive(connection, std::move(partial));
+            ++inputsReadyCount;
+        });
+        return;
+    }
+
     ++inputsDeclaredCount;
     node.addCallback([this](const std::vector<TInput> &output){
-        if(computeInInputNode)
+        if(mode == Mode::Collect)
+        {
+            std::lock_guard lock(addMutex);
+            values.insert(values.end(), output.begin(), output.end());
+        }
+        else if(mode == Mode::Striped)
+            // the array is folded without the lock, the stripe is locked once
+            addPartial(foldArray(output));
+        else
             for(const auto &v : output)
                 add(v);
-        else
+        ++inputsReadyCount;
+    }, TNode::getId(), [this](std::vector<TInput> &&output){
+        if(mode == Mode::Collect)
         {
             std::lock_guard lock(addMutex);
-            for(const auto &v : output)
-                std::get<0>(TNode::inputs)->push_back(v);
+            values.insert(values.end(), std::make_move_iterator(output.begin()), std::make_move_iterator(output.end()));
         }
+        else if(mode == Mode::Striped)
+            addPartial(foldArray(output));
+        else
+            for(auto &v : output)
+                add(std::move(v));
         ++inputsReadyCount;
-    }, TNode::getId());
+    });
 }
 
 
@@ -3,18 +3,78 @@
 
 #include <memory>
 #include <set>
+#include <map>
+#include <typeindex>
+#include <ranges>
+#include <limits>
+#include <chrono>
+#include <algorithm>
+#include <future>
 #include "Node.hpp"
+#include "InputNode.hpp"
+#include "Arena.hpp"
+#include "Profiler.hpp"
 #include "ThreadsPool.hpp"
+#include "Executor.hpp"
+#include "Topology.hpp"
 
 
+/**
+ * @brief Order in which ComputationalGraph runs the nodes which are ready.
+ */
+enum class SchedulingPolicy
+{
+    Fifo,           // ready nodes are submitted to the executor as soon as their inputs are computed
+    CriticalPath,   // ready nodes with the longest remaining path to a sink (bottom level) are run first
+    MemoryAware     // ready nodes which release more bytes of results than they allocate are run first
+};
+
+
+/**
+ * @brief How ComputationalGraph runs the node once its inputs are computed.
+ */
+enum class NodeExecution
+{
+    Auto,   // inline if the measured cost is below the inline threshold, otherwise a task of the executor
+    Inline, // always run by the thread which computed the last input
+    Spawn   // always submitted to the executor as a separate task
+};
+
+
+/**
+ * @brief Graph of nodes which are computed in parallel by the executor.
+ * @tparam TExecutor executor which runs the nodes, e.g. ThreadsPool or WorkStealingPool.
+ */
+template <Executor TExecutor = ThreadsPool<>>
 class ComputationalGraph
 {
 public:
     /**
-     * @brief Creates ComputationalGraph with ThreadPool with specified count of threads.
+     * @brief Runs the node instead of the graph, see setNodeRunner.
+     */
+    using TNodeRunner = std::function<void(INode &node, const INode::TSpawn &spawn, INode::TDone done)>;
+
+    /**
+     * @brief Creates ComputationalGraph with executor with specified count of threads.
      * @param threadsCount_ count of threads.
+     * @param arenaSize size of the first block of the arena owned by the graph.
+     * If it is not 0, nodes and their connections are allocated contiguously in the arena,
+     * which is released at once when the graph is destroyed. Otherwise they are allocated on the heap.
      */
-    explicit ComputationalGraph(int threadsCount_);
+    explicit ComputationalGraph(int threadsCount_, size_t arenaSize = 0);
+
+    /**
+     * @brief Creates ComputationalGraph running the nodes by the executor shared with other graphs,
+     * so many graphs in one process do not oversubscribe the cores.
+     * @param executor_ the executor, it must outlive the graph.
+     * @param arenaSize see the constructor above.
+     */
+    explicit ComputationalGraph(TExecutor &executor_, size_t arenaSize = 0);
+
+    /**
+     * @brief Waits until the run started by runAsync is completed.
+     */
+    ~ComputationalGraph();
 
     /**
      * @brief Adds node of type TNode to graph.
@@ -36,15 +96,16 @@ public:
 
     /**
      * @brief Adds input Node.
-     * Input node is just a Node with no inputs.
+     * Input node is a Node with no inputs, which passes the value of its binding to the outputs.
+     * Bindings of all inputs are stored in the table of the graph, which is preallocated in chunks.
      * @tparam T type of the output of added node (actually just type of the input).
-     * @return reference to the added Node.
+     * @return reference to the added Node, it converts to InputHandle<T>.
      */
     template <typename T>
-    Node<T>& addInput();
+    InputNode<T>& addInput();
 
     /**
-     * @brief Sets input to val.
+     * @brief Sets input to val and marks it dirty.
      * @tparam T type of the input.
      * @param id input id.
      * @param val input value.
@@ -52,96 +113,1413 @@ public:
     template <typename T>
     void setInput(size_t id, T &&val);
 
+    /**
+     * @brief Sets input to val and marks it dirty, without looking the node up.
+     * The value is assigned to the binding, so the storage of the previous value is reused.
+     * @param input the input.
+     * @param val input value.
+     */
+    template <typename T, typename TT>
+    void setInput(const InputHandle<T> &input, TT &&val);
+
+    template <typename T, typename TT>
+    void setInput(InputNode<T> &input, TT &&val)
+    {setInput(InputHandle<T>(input), std::forward<TT>(val));}
+
+    /**
+     * @brief Sets inputs of the same type, e.g. thousands of them, as setInput does.
+     * @param inputs range of InputHandle<T>.
+     * @param values range of the values, i-th value is set to the i-th input.
+     */
+    template <std::ranges::input_range THandles, std::ranges::input_range TValues>
+    void setInputs(const THandles &inputs, TValues &&values);
+
+    /**
+     * @brief Sets inputs of different types, e.g. setInputs(std::tie(x, names), 4, std::move(strings)).
+     * @param inputs tuple of InputHandle or InputNode.
+     * @param values i-th value is set to the i-th input.
+     */
+    template <class ...THandles, class ...TValues>
+        requires (sizeof...(THandles) == sizeof...(TValues))
+    void setInputs(const std::tuple<THandles...> &inputs, TValues&& ...values);
+
+    /**
+     * @brief Marks node and all nodes depending on it to be recomputed on the next run.
+     * Should be called if the node was changed outside of the graph (e.g. by Node::setFunction).
+     * @param id node id.
+     */
+    void markDirty(size_t id);
+
+    /**
+     * @brief Builds the execution plan: compact (CSR) snapshot of the topology with nodes
+     * in topological order and inputs count of every node.
+     * It is called by run() automatically if nodes were added since the last call,
+     * but it must be called explicitly if connections between existing nodes were changed.
+     * All nodes are marked dirty.
+     * @throws std::runtime_error if the graph has a cycle.
+     */
+    void prepare();
+
+    /**
+     * @brief Optimizes the graph once it is built, then builds the plan as prepare() does.
+     * Common subexpressions are eliminated: pure nodes (see Node::setPure) of the same type, with the same key
+     * and the same producers, are merged into the first of them, which feeds the consumers of all of them.
+     * Nodes marked by markOutput are not merged away. Dead nodes are eliminated: from now on runs compute
+     * only the nodes required by the outputs marked by markOutput, or by all sinks if none is marked,
+     * as run(targetIds) does. Merged nodes are never computed, so their results must not be read.
+     * @return count of merged nodes.
+     * @throws std::runtime_error if the graph has a cycle.
+     */
+    size_t optimize();
+
+    /**
+     * @brief Returns all nodes to the state before run and marks them dirty.
+     * Inputs set with setInput are kept.
+     */
+    void reset();
+
     /**
      * @brief Run all computations and wait until they are ended.
+     * Can be called many times. Only dirty nodes are recomputed,
+     * other nodes keep their results from the previous run and feed them to the recomputed ones.
      */
     void run();
 
+    /**
+     * @brief Runs only the nodes required by the targets: the dirty targets and their dirty ancestors,
+     * then waits until they are computed. Other dirty nodes are left dirty and are computed by a later run
+     * which requires them, so a large graph may be queried for a few of its sinks.
+     * If results are released (see setReleaseResults), targets read after the run should be marked by markOutput.
+     * @param targetIds ids of the nodes whose results are needed.
+     * @throws std::runtime_error if a target is not a node of the graph.
+     */
+    void run(const std::vector<size_t> &targetIds);
+
+    /**
+     * @brief Starts the run like run(), but returns without waiting for it.
+     * The graph (its inputs, nodes and settings) must not be changed until the run is completed,
+     * the next run waits for the previous one.
+     * @return future which is ready once the run is completed.
+     */
+    std::future<void> runAsync();
+
+    /**
+     * @brief Starts the run like run(), but returns without waiting for it.
+     * @param onCompleted called by the thread which completes the run (by this one if there is nothing to run).
+     * When it is called the next run may be started, e.g. by the callback itself.
+     */
+    void runAsync(std::function<void()> onCompleted);
+
+    /**
+     * @brief Waits until the run started by runAsync is completed.
+     */
+    void wait();
+
+    /**
+     * @brief Runs the graph for every element of the batch.
+     * Plan is built and input nodes are resolved once for the whole batch,
+     * inputs refer to the batch elements instead of copying them.
+     * Elements are run one after another, since nodes keep the state of a single run;
+     * GraphPool::runBatch keeps several elements in flight, each in its own instance of the graph.
+     * After the call inputs keep the values of the last element, or their previous values if a run throws.
+     * @tparam TBatch range of tuples, i-th element of a tuple is the value of the input with id inputsIds_[i].
+     * @tparam TOutputNodes types of nodes whose results are collected.
+     * @param batch input sets.
+     * @param inputsIds_ ids of the input nodes which are set from the batch elements.
+     * @param outputNodes nodes whose results are collected.
+     * @return tuple of results of outputNodes for every element of the batch.
+     */
+    template <std::ranges::input_range TBatch, class ...TOutputNodes>
+    auto runBatch(const TBatch &batch,
+                  const std::array<size_t, std::tuple_size_v<std::ranges::range_value_t<TBatch>>> &inputsIds_,
+                  const TOutputNodes& ...outputNodes);
+
+    /**
+     * @brief Sets the order in which ready nodes are run, Fifo by default.
+     * With CriticalPath the graph computes the bottom level of every scheduled node
+     * (the cost of the longest path from the node to a sink) before each run and dispatches ready nodes
+     * by it, so long branches are not delayed behind many cheap nodes.
+     * Costs are set by setNodeCost or measured: the running time of the node is sampled every 16th run
+     * and averaged over the samples.
+     * With MemoryAware ready nodes are dispatched by the bytes they release (results of producers
+     * which they are the last to read) minus the bytes they allocated in the previous run,
+     * so it is useful along with setReleaseResults.
+     * @param policy_ the policy, it must not be changed while the graph is running.
+     */
+    void setSchedulingPolicy(SchedulingPolicy policy_);
+
+    /**
+     * @brief Sets the cost of the node used by the CriticalPath policy instead of the measured one.
+     * @param id node id.
+     * @param cost the cost in nanoseconds, or a negative value to measure it again.
+     */
+    void setNodeCost(size_t id, double cost);
+
+    /**
+     * @brief Returns the cost of the node set by setNodeCost or measured by the previous runs.
+     * @param id node id.
+     * @return the cost in nanoseconds, 1 if it is not known yet.
+     */
+    double getNodeCost(size_t id) const;
+
+    /**
+     * @brief Enables the release of intermediate results: once all consumers of the node computed
+     * by the run have read its result, the result is destroyed (or passed to Node::setResultRecycler),
+     * so peak memory is bounded by the results alive at the same time rather than by all of them.
+     * Nodes without consumers and nodes marked by markOutput keep their results. A released node is
+     * computed again by the next run which recomputes any of its consumers. Disabled by default.
+     * @param release whether results are released.
+     */
+    void setReleaseResults(bool release);
+
+    /**
+     * @brief Marks the node as an output of the graph, its result is never released.
+     * @param id node id.
+     */
+    void markOutput(size_t id);
+
+    /**
+     * @brief Returns the peak of bytes of the results alive during the last run: results computed
+     * by the run and results of other nodes read by it, estimated by estimateBytes.
+     * It is tracked if results are released or the policy is MemoryAware, 0 otherwise.
+     */
+    size_t getPeakLiveBytes() const
+    {return peakLiveBytes.load(std::memory_order_relaxed);}
+
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    /**
+     * @brief Returns the profile of the last run: timeline of every computed node
+     * and counters of the executor's workers. Available if COMPUTATIONALGRAPH_PROFILING is defined.
+     */
+    const RunProfile& getProfile() const
+    {return profile;}
+#endif
+
+    /**
+     * @brief Sets the cost below which nodes are run inline: by the thread which computed their last input,
+     * right after it, instead of being submitted to the executor. Costs are measured as for the CriticalPath
+     * policy, nodes are spawned until they are measured. A few microseconds is a reasonable threshold,
+     * it should exceed the cost of the submission of a job. 0 (default) disables it.
+     * @param threshold the threshold in nanoseconds.
+     */
+    void setInlineThreshold(double threshold);
+
+    /**
+     * @brief Overrides how the node is run.
+     * @param id node id.
+     * @param execution Inline or Spawn, or Auto to decide by the measured cost.
+     */
+    void setNodeExecution(size_t id, NodeExecution execution);
+
+    /**
+     * @brief Hints the NUMA domain which should run the node, e.g. the domain holding the memory
+     * the node reads. If the executor has submitTo (WorkStealingPool with pinned workers), the node is submitted
+     * to the workers of the domain and is not continued by a thread of another domain; otherwise it is ignored.
+     * Used by the Fifo policy only. A chain is not fused into a consumer placed in another domain than its producer.
+     * @param id node id.
+     * @param domain index of the domain in CpuTopology, CpuTopology::anyDomain (default) for no preference.
+     */
+    void setNodeDomain(size_t id, size_t domain);
+
+    /**
+     * @brief Makes the graph run the node by the runner when it is ready, e.g. to receive its result
+     * from another process (see DistributedGraph). The runner is called as runner(node, spawn, done)
+     * and follows the protocol of INode::runParallel: it must call done once the result is passed
+     * to the outputs (or left as it is), possibly by another thread.
+     * @param id node id.
+     * @param runner the runner, or an empty function to run the node itself.
+     */
+    void setNodeRunner(size_t id, TNodeRunner runner);
+
+    /**
+     * @brief Returns count of the nodes, ids of the nodes are 0 ... size() - 1.
+     */
+    size_t size() const
+    {return graph.size();}
+
+    INode& getNode(size_t id)
+    {return *graph[id];}
+
+    const INode& getNode(size_t id) const
+    {return *graph[id];}
+
 private:
-    inline void onComplete(size_t completedId);
+    template <typename T>
+    InputNode<T>* getInputNode(size_t id);
+
+    template <class TN, class ...TArgs>
+    TN& emplaceNode(TArgs&& ...args);
+
+    inline bool startRun(const std::vector<size_t> *targetIds = nullptr);
+    inline void selectRequired(const std::vector<size_t> &targetIds);
+    inline void restoreDeferred();
+    inline size_t fusedNext(size_t index) const;
+    inline void finishRun();
+    inline void markDirtyIndex(size_t index);
+    inline void runTask(size_t index);
+    inline void runTasks(size_t index, std::vector<size_t> &inlined);
+    inline size_t runChain(size_t index, size_t completedNodesCount, std::vector<size_t> &inlined);
+    inline size_t onComplete(size_t completedIndex, size_t completedNodesCount, std::vector<size_t> &inlined);
+    inline void updateExecutions();
+    inline void submitNode(size_t index);
+    inline bool isLocal(size_t index) const;
+    inline void computeBottomLevels();
+    inline void measureCost(size_t index, std::chrono::steady_clock::time_point start);
+    inline void pushReady(size_t index);
+    inline size_t popReady();
+    inline double memoryPriority(size_t index) const;
+    inline void onComputed(size_t index);
+    inline void addLiveBytes(size_t bytes);
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    inline void finishProfile(size_t index);
+#endif
+
+    static constexpr size_t noNode = std::numeric_limits<size_t>::max();
+    static constexpr double unknownCost = -1;
+    static constexpr size_t costSamplingPeriod = 16;
 
-    std::vector<std::unique_ptr<INode>> graph;
-    std::vector<std::atomic<bool>> isScheduled;
+    /**
+     * @brief Destroys the node and returns its memory to the resource it was allocated from.
+     */
+    struct NodeDeleter
+    {
+        std::pmr::memory_resource *resource;
+        size_t size;
+        size_t alignment;
+
+        void operator()(INode *node) const
+        {
+            void *memory = dynamic_cast<void*>(node);
+            node->~INode();
+            resource->deallocate(memory, size, alignment);
+        }
+    };
+
+    // the arena is declared before the nodes, so it is destroyed after them
+    std::unique_ptr<Arena> arena;
+    std::pmr::memory_resource *nodesResource;
+    // bindings are destroyed after the nodes reading them
+    InputBindingTable inputBindings;
+    std::vector<std::unique_ptr<INode, NodeDeleter>> graph;
     std::set<size_t> inputsIds;
-    ThreadsPool<> threadsPool;
+    // the executor is either owned by the graph or shared with other graphs
+    std::unique_ptr<TExecutor> ownedExecutor;
+    TExecutor &executor;
+    INode::TSpawn spawn;
+
+    // execution plan, nodes are indexed by their position in topological order
+    size_t plannedSize = 0;
+    std::vector<size_t> planIds;    // node id of every plan index
+    std::vector<size_t> planIndex;  // plan index of every node id
+    std::vector<INode*> planNodes;
+    // outputs of node i are outputIndices[outputsBegin[i]] ... outputIndices[outputsBegin[i + 1] - 1]
+    std::vector<size_t> outputsBegin;
+    std::vector<size_t> outputIndices;
+    // producers of node i are stored the same way, with the count of connections from every producer
+    std::vector<size_t> producersBegin;
+    std::vector<std::pair<size_t, size_t>> producerEntries;
+    std::vector<size_t> inputsCount;
+    std::vector<size_t> chainNext;  // the only consumer of the node if the node is its only producer
+    std::unique_ptr<std::atomic<size_t>[]> pendingInputs;
+
+    // incremental state
+    std::vector<char> dirty;
+    std::vector<size_t> dirtyIds;  // plan indices
+    std::vector<size_t> roots;
+    size_t scheduledCount = 0;
+
+    // demand-driven runs, dirty nodes which are not required by the run are deferred to a later one
+    std::vector<size_t> deferredIds;  // plan indices
+    std::vector<char> required;       // plan indices, set only while the required nodes are selected
+    std::vector<char> keptResults;    // plan indices, producers read by the deferred nodes are not released
+    std::vector<size_t> keptIds;
+    bool pruneDeadNodes = false;      // set by optimize
+    std::vector<char> mergedNodes;    // node ids
+    std::vector<size_t> liveTargets;  // node ids, outputs required by every run if dead nodes are pruned
+    bool liveTargetsStale = true;
+
+    // critical path scheduling, costs are indexed by node ids
+    SchedulingPolicy policy = SchedulingPolicy::Fifo;
+    std::vector<double> costs;
+    std::vector<char> fixedCosts;
+    std::vector<double> priorities;  // plan indices, bottom levels or bytes released by the node (MemoryAware)
+    bool measureCosts = false;
+    size_t runsCount = 0;
+    // max-heap of ready nodes by priority, every element has a job in the executor which pops it
+    std::vector<size_t> readyHeap;
+    std::mutex readyMutex;
+
+    // liveness of results
+    bool releaseResults = false;
+    bool trackMemory = false;
+    std::vector<char> graphOutputs;     // node ids, as set by markOutput
+    std::unique_ptr<std::atomic<size_t>[]> pendingReaders; // connections to consumers which have not run yet
+    std::vector<size_t> resultBytes;    // plan indices, bytes of the result when it was computed
+    std::atomic<size_t> liveBytes{0};
+    std::atomic<size_t> peakLiveBytes{0};
+
+    // adaptive granularity
+    double inlineThreshold = 0;
+    std::vector<NodeExecution> executions;     // node ids, as set by setNodeExecution
+    std::vector<NodeExecution> planExecutions; // plan indices, Auto is resolved for the current run
+    std::vector<size_t> domains;               // node ids, as set by setNodeDomain
+    std::vector<TNodeRunner> runners;          // node ids, as set by setNodeRunner
+
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    RunProfile profile;
+    std::vector<NodeProfile> nodeProfiles;  // plan indices
+    std::vector<size_t> profiledIndices;
+#endif
 
     std::atomic<size_t> completedCount;
+    std::function<void()> onRunCompleted;
+    bool allCompletedFlag = true;  // no run is in progress
     std::condition_variable allCompleted;
     std::mutex completedMutex;
 };
 
 
 
-ComputationalGraph::ComputationalGraph(int threadsCount_):
-    threadsPool(threadsCount_)
+template <Executor TExecutor>
+ComputationalGraph<TExecutor>::ComputationalGraph(int threadsCount_, size_t arenaSize):
+    arena(arenaSize != 0 ? std::make_unique<Arena>(arenaSize) : nullptr),
+    nodesResource(arena ? static_cast<std::pmr::memory_resource*>(arena.get()) : std::pmr::new_delete_resource()),
+    ownedExecutor(std::make_unique<TExecutor>(threadsCount_)),
+    executor(*ownedExecutor),
+    spawn([this](std::function<void()> job){executor.submit(std::move(job));})
 {}
 
+template <Executor TExecutor>
+ComputationalGraph<TExecutor>::ComputationalGraph(TExecutor &executor_, size_t arenaSize):
+    arena(arenaSize != 0 ? std::make_unique<Arena>(arenaSize) : nullptr),
+    nodesResource(arena ? static_cast<std::pmr::memory_resource*>(arena.get()) : std::pmr::new_delete_resource()),
+    executor(executor_),
+    spawn([this](std::function<void()> job){executor.submit(std::move(job));})
+{}
+
+template <Executor TExecutor>
+ComputationalGraph<TExecutor>::~ComputationalGraph()
+{
+    wait();
+}
+
+template <Executor TExecutor>
 template <template<typename TOutput_, typename ...TInputs_> class TNode, typename TOutput, typename ...TInputs, class ...TArgs>
-TNode<TOutput, TInputs...>& ComputationalGraph::addNode(TArgs&& ...args)
+TNode<TOutput, TInputs...>& ComputationalGraph<TExecutor>::addNode(TArgs&& ...args)
+{
+    return emplaceNode<TNode<TOutput, TInputs...>>(std::forward<TArgs>(args)...);
+}
+
+template <Executor TExecutor>
+template <class TN, class ...TArgs>
+TN& ComputationalGraph<TExecutor>::emplaceNode(TArgs&& ...args)
 {
-    std::unique_ptr<TNode<TOutput, TInputs...>> node{new TNode<TOutput, TInputs...>(graph.size(), std::forward<TArgs>(args)...)};
-    TNode<TOutput, TInputs...> &ret_ref = *node;
-    graph.emplace_back(std::move(node));
-    return ret_ref;
+    NodeDeleter deleter{nodesResource, sizeof(TN), alignof(TN)};
+    void *memory = nodesResource->allocate(sizeof(TN), alignof(TN));
+    TN *node;
+    try
+    {
+        node = ::new(memory) TN(graph.size(), std::forward<TArgs>(args)...);
+    }
+    catch(...)
+    {
+        nodesResource->deallocate(memory, sizeof(TN), alignof(TN));
+        throw;
+    }
+
+    std::unique_ptr<INode, NodeDeleter> owner(node, deleter);
+    node->setMemoryResource(nodesResource);
+    graph.emplace_back(std::move(owner));
+    return *node;
 }
 
+template <Executor TExecutor>
 template <typename TOutput, typename ...TInputs, class ...TArgs>
-Node<TOutput, TInputs...>& ComputationalGraph::addNode(TArgs&& ...args)
+Node<TOutput, TInputs...>& ComputationalGraph<TExecutor>::addNode(TArgs&& ...args)
 {
     return addNode<Node, TOutput, TInputs...>(std::forward<TArgs>(args)...);
 }
 
+template <Executor TExecutor>
 template <typename T>
-Node<T>& ComputationalGraph::addInput()
+InputNode<T>& ComputationalGraph<TExecutor>::addInput()
 {
     inputsIds.insert(graph.size());
-    return addNode<T>();
+    return emplaceNode<InputNode<T>>(inputBindings.allocate<T>());
 }
 
+template <Executor TExecutor>
 template <typename T>
-void ComputationalGraph::setInput(size_t id, T &&val)
+InputNode<T>* ComputationalGraph<TExecutor>::getInputNode(size_t id)
 {
-    auto inputNode = dynamic_cast<Node<std::remove_reference_t<T>>*>(graph[id].get());
+    auto inputNode = dynamic_cast<InputNode<T>*>(graph[id].get());
     if(inputNode == nullptr)
         throw std::runtime_error("Bad input node");
 
-    inputNode->setFunction([v = std::forward<T>(val)]{return v;});
+    return inputNode;
 }
 
-void ComputationalGraph::run()
+template <Executor TExecutor>
+template <typename T>
+void ComputationalGraph<TExecutor>::setInput(size_t id, T &&val)
 {
-    std::unique_lock completedLock(completedMutex);
-    isScheduled = std::vector<std::atomic<bool>>(graph.size());
-    for(size_t i = 0; i < graph.size(); ++i)
-        isScheduled[i] = false;
+    getInputNode<std::remove_cvref_t<T>>(id)->getBinding().set(std::forward<T>(val));
+    markDirty(id);
+}
+
+template <Executor TExecutor>
+template <typename T, typename TT>
+void ComputationalGraph<TExecutor>::setInput(const InputHandle<T> &input, TT &&val)
+{
+    input.getBinding().set(std::forward<TT>(val));
+    markDirty(input.getId());
+}
 
-    for(size_t i : inputsIds)
+template <Executor TExecutor>
+template <std::ranges::input_range THandles, std::ranges::input_range TValues>
+void ComputationalGraph<TExecutor>::setInputs(const THandles &inputs, TValues &&values)
+{
+    auto value = std::ranges::begin(values);
+    for(const auto &input : inputs)
     {
-        isScheduled[i] = true;
-        threadsPool.submit([i, this]{
-            graph[i]->run();
-            onComplete(i);
-        });
+        if(value == std::ranges::end(values))
+            throw std::runtime_error("Fewer values than inputs");
+        // values of an rvalue range are moved to the bindings
+        if constexpr(std::is_rvalue_reference_v<TValues&&> && !std::is_const_v<std::remove_reference_t<TValues>>)
+            setInput(input, std::move(*value));
+        else
+            setInput(input, *value);
+        ++value;
     }
+}
+
+template <Executor TExecutor>
+template <class ...THandles, class ...TValues>
+    requires (sizeof...(THandles) == sizeof...(TValues))
+void ComputationalGraph<TExecutor>::setInputs(const std::tuple<THandles...> &inputs, TValues&& ...values)
+{
+    [&]<size_t ...i>(std::index_sequence<i...>)
+    {
+        (setInput(std::get<i>(inputs), std::forward<TValues>(values)), ...);
+    }(std::index_sequence_for<THandles...>());
+}
+
+template <Executor TExecutor>
+template <std::ranges::input_range TBatch, class ...TOutputNodes>
+auto ComputationalGraph<TExecutor>::runBatch(const TBatch &batch,
+                                             const std::array<size_t, std::tuple_size_v<std::ranges::range_value_t<TBatch>>> &inputsIds_,
+                                             const TOutputNodes& ...outputNodes)
+{
+    using TElement = std::ranges::range_value_t<TBatch>;
+    using TResults = std::tuple<typename std::remove_cvref_t<decltype(outputNodes.getResult())>::value_type...>;
+
+    auto inputNodes = [this, &inputsIds_] <size_t ...i> (std::index_sequence<i...>)
+    {
+        return std::tuple{getInputNode<std::tuple_element_t<i, TElement>>(inputsIds_[i])...};
+    }(std::make_index_sequence<std::tuple_size_v<TElement>>());
+
+    std::vector<TResults> results;
+    if constexpr(std::ranges::sized_range<TBatch>)
+        results.reserve(std::ranges::size(batch));
+
+    constexpr auto inputsSequence = std::make_index_sequence<std::tuple_size_v<TElement>>();
+    // elements of forward ranges of lvalues stay valid during the call, other elements are kept by value
+    // while they are run, so the bindings never refer to destroyed elements
+    constexpr bool stableElements = std::ranges::forward_range<const TBatch> &&
+                                    std::is_lvalue_reference_v<std::ranges::range_reference_t<const TBatch>>;
+    using TElementHolder = std::conditional_t<stableElements, const TElement&, TElement>;
+    try
+    {
+        auto end = std::ranges::end(batch);
+        for(auto it = std::ranges::begin(batch); it != end;)
+        {
+            TElementHolder element = *it;
+            // bindings refer to the batch elements while running, so no copies are made
+            [&inputNodes, &element] <size_t ...i> (std::index_sequence<i...>)
+            {
+                (std::get<i>(inputNodes)->getBinding().bind(std::get<i>(element)) , ...);
+            }(inputsSequence);
+            for(size_t id : inputsIds_)
+                markDirty(id);
+
+            run();
+            results.emplace_back(*outputNodes.getResultRef()...);
+
+            // the batch may not outlive this call, so inputs keep copies of the last element
+            if(++it == end)
+                [&inputNodes, &element] <size_t ...i> (std::index_sequence<i...>)
+                {
+                    if constexpr(stableElements)
+                        (std::get<i>(inputNodes)->getBinding().set(std::get<i>(element)) , ...);
+                    else
+                        (std::get<i>(inputNodes)->getBinding().set(std::get<i>(std::move(element))) , ...);
+                }(inputsSequence);
+        }
+    }
+    catch(...)
+    {
+        // inputs must not refer to the elements after the call
+        std::apply([](auto* ...nodes){(nodes->getBinding().unbind() , ...);}, inputNodes);
+        throw;
+    }
+
+    return results;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::markDirty(size_t id)
+{
+    // nodes added after the last prepare() are recomputed along with everything else
+    if(plannedSize == graph.size())
+        markDirtyIndex(planIndex[id]);
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::markDirtyIndex(size_t index)
+{
+    if(dirty[index])
+        return;
+
+    // dirtyIds is used as the queue of the traversal
+    size_t next = dirtyIds.size();
+    dirty[index] = true;
+    dirtyIds.push_back(index);
+    for(; next < dirtyIds.size(); ++next)
+    {
+        size_t i = dirtyIds[next];
+        for(size_t j = outputsBegin[i]; j < outputsBegin[i + 1]; ++j)
+            if(!dirty[outputIndices[j]])
+            {
+                dirty[outputIndices[j]] = true;
+                dirtyIds.push_back(outputIndices[j]);
+            }
+    }
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::prepare()
+{
+    plannedSize = graph.size();
+    std::vector<size_t> pending(plannedSize, 0);
+    for(const auto &node : graph)
+        for(size_t childId : node->getOutputs())
+            ++pending[childId];
+
+    // depth-first topological order: a node usually follows its producer,
+    // so the continuation of a task (see runTask) and its counters are close in memory
+    std::vector<size_t> stack;
+    for(size_t id = plannedSize; id-- > 0;)
+        if(pending[id] == 0)
+            stack.push_back(id);
+
+    planIds.clear();
+    planIds.reserve(plannedSize);
+    while(!stack.empty())
+    {
+        size_t id = stack.back();
+        stack.pop_back();
+        planIds.push_back(id);
+        auto nodeOutputs = graph[id]->getOutputs();
+        for(auto it = nodeOutputs.rbegin(); it != nodeOutputs.rend(); ++it)
+            if(--pending[*it] == 0)
+                stack.push_back(*it);
+    }
+    if(planIds.size() != plannedSize)
+    {
+        plannedSize = 0;
+        throw std::runtime_error("Graph has a cycle");
+    }
+
+    planIndex.resize(plannedSize);
+    planNodes.resize(plannedSize);
+    for(size_t i = 0; i < plannedSize; ++i)
+    {
+        planIndex[planIds[i]] = i;
+        planNodes[i] = graph[planIds[i]].get();
+    }
+
+    outputsBegin.assign(plannedSize + 1, 0);
+    for(size_t i = 0; i < plannedSize; ++i)
+        outputsBegin[i + 1] = outputsBegin[i] + planNodes[i]->getOutputs().size();
+    outputIndices.resize(outputsBegin[plannedSize]);
+    inputsCount.assign(plannedSize, 0);
+    for(size_t i = 0; i < plannedSize; ++i)
+    {
+        size_t j = outputsBegin[i];
+        for(size_t childId : planNodes[i]->getOutputs())
+        {
+            outputIndices[j++] = planIndex[childId];
+            ++inputsCount[planIndex[childId]];
+        }
+    }
+
+    // a producer connected to the same node several times is stored once, with the count of connections
+    std::vector<size_t> lastProducer(plannedSize, noNode);
+    producersBegin.assign(plannedSize + 1, 0);
+    for(size_t i = 0; i < plannedSize; ++i)
+        for(size_t j = outputsBegin[i]; j < outputsBegin[i + 1]; ++j)
+            if(lastProducer[outputIndices[j]] != i)
+            {
+                lastProducer[outputIndices[j]] = i;
+                ++producersBegin[outputIndices[j] + 1];
+            }
+    for(size_t i = 0; i < plannedSize; ++i)
+        producersBegin[i + 1] += producersBegin[i];
+
+    producerEntries.resize(producersBegin[plannedSize]);
+    std::vector<size_t> producersEnd(producersBegin.begin(), producersBegin.end() - 1);
+    std::fill(lastProducer.begin(), lastProducer.end(), noNode);
+    for(size_t i = 0; i < plannedSize; ++i)
+        for(size_t j = outputsBegin[i]; j < outputsBegin[i + 1]; ++j)
+        {
+            size_t childIndex = outputIndices[j];
+            if(lastProducer[childIndex] != i)
+            {
+                lastProducer[childIndex] = i;
+                producerEntries[producersEnd[childIndex]++] = {i, 1};
+            }
+            else
+                ++producerEntries[producersEnd[childIndex] - 1].second;
+        }
+
+    // single-producer/single-consumer chains are fused: the consumer is run right after the producer
+    // in the same task, bypassing the counters and the executor
+    chainNext.assign(plannedSize, noNode);
+    for(size_t i = 0; i < plannedSize; ++i)
+        if(outputsBegin[i + 1] - outputsBegin[i] == 1 && inputsCount[outputIndices[outputsBegin[i]]] == 1)
+            chainNext[i] = outputIndices[outputsBegin[i]];
 
+    pendingInputs.reset(new std::atomic<size_t>[plannedSize]);
+    costs.resize(plannedSize, unknownCost);
+    fixedCosts.resize(plannedSize, false);
+    priorities.resize(plannedSize);
+    graphOutputs.resize(plannedSize, false);
+    pendingReaders.reset(new std::atomic<size_t>[plannedSize]);
+    resultBytes.assign(plannedSize, 0);
+    executions.resize(plannedSize, NodeExecution::Auto);
+    planExecutions.resize(plannedSize);
+    domains.resize(plannedSize, CpuTopology::anyDomain);
+    runners.resize(plannedSize);
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    nodeProfiles.assign(plannedSize, {});
+    for(size_t i = 0; i < plannedSize; ++i)
+        nodeProfiles[i].id = planIds[i];
+#endif
+    dirty.assign(plannedSize, true);
+    dirtyIds.resize(plannedSize);
+    std::iota(dirtyIds.begin(), dirtyIds.end(), 0);
+    required.assign(plannedSize, false);
+    keptResults.assign(plannedSize, false);
+    keptIds.clear();
+    liveTargetsStale = true;
+}
+
+template <Executor TExecutor>
+size_t ComputationalGraph<TExecutor>::optimize()
+{
+    wait();
+    prepare();
+
+    // plan order is topological, so the producers of a node are merged before the node is looked up;
+    // producers are compared by the nodes they were merged into
+    std::vector<size_t> mergedInto(plannedSize);
+    std::iota(mergedInto.begin(), mergedInto.end(), 0);
+    mergedNodes.resize(plannedSize, false);
+    std::map<std::tuple<std::type_index, uint64_t, std::vector<size_t>>, size_t> pureNodes;
+    size_t mergedCount = 0;
+    for(size_t i = 0; i < plannedSize; ++i)
+    {
+        INode &node = *planNodes[i];
+        std::span<const size_t> producers = node.getProducers();
+        // nodes without producers (e.g. inputs) and nodes with other connections are not compared
+        if(node.getFunctionKey() == 0 || producers.empty() || producers.size() != inputsCount[i] ||
+           std::ranges::find(producers, noNode) != producers.end())
+            continue;
+
+        std::vector<size_t> key(producers.size());
+        for(size_t k = 0; k < producers.size(); ++k)
+            key[k] = mergedInto[producers[k]];
+        auto [it, inserted] = pureNodes.try_emplace({std::type_index(typeid(node)), node.getFunctionKey(), std::move(key)},
+                                                    planIds[i]);
+        size_t id = planIds[i];
+        if(inserted || (id < graphOutputs.size() && graphOutputs[id]) || !graph[it->second]->adoptOutputs(node))
+            continue;
+        // otherwise the duplicate would be made dirty by its producers and keep their results alive
+        for(size_t producerId : producers)
+            graph[producerId]->disconnectOutput(id);
+        mergedInto[id] = it->second;
+        mergedNodes[id] = true;
+        ++mergedCount;
+    }
+
+    pruneDeadNodes = true;
+    // outputs of the merged nodes are moved, so the plan is built again
+    prepare();
+    return mergedCount;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::reset()
+{
+    if(plannedSize != graph.size())
+        prepare();
+    else
+    {
+        std::fill(dirty.begin(), dirty.end(), true);
+        dirtyIds.resize(plannedSize);
+        std::iota(dirtyIds.begin(), dirtyIds.end(), 0);
+    }
+
+    for(auto &node : graph)
+        node->reset();
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::run()
+{
+    wait();
+    if(startRun())
+        wait();
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::run(const std::vector<size_t> &targetIds)
+{
+    wait();
+    if(startRun(&targetIds))
+        wait();
+}
+
+template <Executor TExecutor>
+std::future<void> ComputationalGraph<TExecutor>::runAsync()
+{
+    auto completed = std::make_shared<std::promise<void>>();
+    std::future<void> future = completed->get_future();
+    runAsync([completed]{completed->set_value();});
+    return future;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::runAsync(std::function<void()> onCompleted)
+{
+    wait();
+    onRunCompleted = std::move(onCompleted);
+    if(!startRun())
+    {
+        auto callback = std::move(onRunCompleted);
+        callback();
+    }
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::wait()
+{
+    std::unique_lock completedLock(completedMutex);
     allCompleted.wait(completedLock, [this]{
-        return completedCount == graph.size();
+        return allCompletedFlag;
+    });
+}
+
+template <Executor TExecutor>
+bool ComputationalGraph<TExecutor>::startRun(const std::vector<size_t> *targetIds)
+{
+    if(plannedSize != graph.size())
+        prepare();
+    // checked before anything is changed, so the graph is left as it was
+    if(targetIds != nullptr)
+        for(size_t id : *targetIds)
+            if(id >= plannedSize)
+                throw std::runtime_error("Bad target node");
+
+    for(size_t i : keptIds)
+        keptResults[i] = false;
+    keptIds.clear();
+    if(targetIds != nullptr)
+        selectRequired(*targetIds);
+    else if(pruneDeadNodes)
+    {
+        if(liveTargetsStale)
+        {
+            // marked outputs, or the sinks if none is marked, except the merged nodes
+            liveTargets.clear();
+            for(size_t id = 0; id < plannedSize; ++id)
+                if(id < graphOutputs.size() && graphOutputs[id])
+                    liveTargets.push_back(id);
+            if(liveTargets.empty())
+                for(size_t id = 0; id < plannedSize; ++id)
+                    if(graph[id]->getOutputs().empty() && !(id < mergedNodes.size() && mergedNodes[id]))
+                        liveTargets.push_back(id);
+            liveTargetsStale = false;
+        }
+        selectRequired(liveTargets);
+    }
+    else
+        // results moved out by consumers can not be passed again, so such producers are recomputed too
+        for(size_t k = 0; k < dirtyIds.size(); ++k)
+            for(size_t j = producersBegin[dirtyIds[k]]; j < producersBegin[dirtyIds[k] + 1]; ++j)
+            {
+                size_t producerIndex = producerEntries[j].first;
+                if(!dirty[producerIndex] && planNodes[producerIndex]->isResultReleased())
+                    markDirtyIndex(producerIndex);
+            }
+
+    scheduledCount = dirtyIds.size();
+    trackMemory = releaseResults || policy == SchedulingPolicy::MemoryAware;
+    liveBytes.store(0, std::memory_order_relaxed);
+    peakLiveBytes.store(0, std::memory_order_relaxed);
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    profile.begin = std::chrono::steady_clock::now();
+    profile.end = profile.begin;
+    profile.nodes.clear();
+    profiledIndices.assign(dirtyIds.begin(), dirtyIds.end());
+#endif
+    if(scheduledCount == 0)
+    {
+        restoreDeferred();
+        return false;
+    }
+
+    for(size_t i : dirtyIds)
+    {
+        planNodes[i]->reset();
+        pendingInputs[i] = inputsCount[i];
+    }
+
+    // clean producers are not run again, so they pass their results to the dirty nodes right now
+    for(size_t i : dirtyIds)
+        for(size_t j = producersBegin[i]; j < producersBegin[i + 1]; ++j)
+        {
+            auto [producerIndex, connectionsCount] = producerEntries[j];
+            if(!dirty[producerIndex])
+            {
+                pendingInputs[i] -= connectionsCount;
+                planNodes[producerIndex]->emitTo(planIds[i]);
+                // the result read by the run is alive until its last reader is computed
+                if(trackMemory && pendingReaders[producerIndex] == 0)
+                {
+                    resultBytes[producerIndex] = planNodes[producerIndex]->getResultBytes();
+                    addLiveBytes(resultBytes[producerIndex]);
+                }
+            }
+            // every counter is 0 after the previous run, since all readers were computed
+            if(trackMemory)
+                pendingReaders[producerIndex] += connectionsCount;
+        }
+
+    // costs are sampled, so the clock is read only on every costSamplingPeriod-th run
+    measureCosts = (policy == SchedulingPolicy::CriticalPath || inlineThreshold > 0) &&
+                   runsCount++ % costSamplingPeriod == 0;
+    if(policy == SchedulingPolicy::CriticalPath)
+        computeBottomLevels();
+    updateExecutions();
+
+    // roots must be found before anything is submitted, since running nodes decrease the counters
+    roots.clear();
+    for(size_t i : dirtyIds)
+    {
+        dirty[i] = false;
+        if(pendingInputs[i] == 0)
+            roots.push_back(i);
+    }
+    dirtyIds.clear();
+    // deferred nodes are dirty again before anything is submitted, so completed nodes do not schedule them
+    restoreDeferred();
+
+    completedCount = 0;
+    allCompletedFlag = false;
+    // the run can not be completed (and the next one started by the callback) until the roots are submitted
+    std::lock_guard completedLock(completedMutex);
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    auto readyTime = std::chrono::steady_clock::now();
+    for(size_t i : roots)
+        nodeProfiles[i].ready = readyTime;
+#endif
+    if(policy != SchedulingPolicy::Fifo)
+    {
+        for(size_t i : roots)
+            pushReady(i);
+        for(size_t k = 0; k < roots.size(); ++k)
+            executor.submit([this]{runTask(popReady());});
+    }
+    else
+        for(size_t i : roots)
+            submitNode(i);
+    return true;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::selectRequired(const std::vector<size_t> &targetIds)
+{
+    // a clean node has only clean producers (dirtiness is propagated to all children),
+    // so the traversal visits only the nodes which are run and their direct producers
+    std::vector<size_t> requiredIds;
+    for(size_t id : targetIds)
+    {
+        size_t index = planIndex[id];
+        if(dirty[index] && !required[index])
+        {
+            required[index] = true;
+            requiredIds.push_back(index);
+        }
+    }
+    for(size_t k = 0; k < requiredIds.size(); ++k)
+        for(size_t j = producersBegin[requiredIds[k]]; j < producersBegin[requiredIds[k] + 1]; ++j)
+        {
+            size_t producerIndex = producerEntries[j].first;
+            if(required[producerIndex])
+                continue;
+            // results moved out by consumers can not be passed again, so such producers are recomputed too,
+            // their other consumers become dirty and are deferred
+            if(!dirty[producerIndex] && planNodes[producerIndex]->isResultReleased())
+                markDirtyIndex(producerIndex);
+            if(dirty[producerIndex])
+            {
+                required[producerIndex] = true;
+                requiredIds.push_back(producerIndex);
+            }
+        }
+
+    // deferred nodes are clean while the run is set up, e.g. they do not add to bottom levels
+    deferredIds.clear();
+    for(size_t i : dirtyIds)
+        if(required[i])
+            required[i] = false;
+        else
+        {
+            dirty[i] = false;
+            deferredIds.push_back(i);
+        }
+    dirtyIds.swap(requiredIds);
+
+    // otherwise a result read by this run and needed by a later one would be computed again
+    if(releaseResults)
+        for(size_t i : deferredIds)
+            for(size_t j = producersBegin[i]; j < producersBegin[i + 1]; ++j)
+            {
+                size_t producerIndex = producerEntries[j].first;
+                if(!keptResults[producerIndex])
+                {
+                    keptResults[producerIndex] = true;
+                    keptIds.push_back(producerIndex);
+                }
+            }
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::restoreDeferred()
+{
+    for(size_t i : deferredIds)
+        dirty[i] = true;
+    dirtyIds.insert(dirtyIds.end(), deferredIds.begin(), deferredIds.end());
+    deferredIds.clear();
+}
+
+template <Executor TExecutor>
+size_t ComputationalGraph<TExecutor>::fusedNext(size_t index) const
+{
+    // the fused consumer is scheduled for this run unless it is deferred (it is still dirty then),
+    // spawned consumers and consumers placed in another domain are scheduled by the counters like any other node
+    size_t next = chainNext[index];
+    if(next == noNode || dirty[next] || planExecutions[next] == NodeExecution::Spawn)
+        return noNode;
+    size_t domain = domains[planIds[next]];
+    return domain == CpuTopology::anyDomain || domain == domains[planIds[index]] ? next : noNode;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::finishRun()
+{
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    profile.end = std::chrono::steady_clock::now();
+    std::sort(profiledIndices.begin(), profiledIndices.end());
+    for(size_t i : profiledIndices)
+        profile.nodes.push_back(nodeProfiles[i]);
+    if constexpr(requires {executor.getWorkerStats();})
+        profile.workers = executor.getWorkerStats();
+#endif
+    // the callback is called after the lock is released, it may start the next run
+    std::function<void()> callback;
+    {
+        std::lock_guard lock(completedMutex);
+        callback = std::move(onRunCompleted);
+        onRunCompleted = nullptr;
+        allCompletedFlag = true;
+        allCompleted.notify_all();
+    }
+    if(callback)
+        callback();
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::runTask(size_t index)
+{
+    std::vector<size_t> inlined;
+    runTasks(index, inlined);
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::runTasks(size_t index, std::vector<size_t> &inlined)
+{
+    // the first ready child is continued on the same thread while its inputs are hot in cache,
+    // inlined nodes are run after it
+    for(;;)
+    {
+        while(index != noNode)
+            index = runChain(index, 0, inlined);
+        if(inlined.empty())
+            return;
+        index = inlined.back();
+        inlined.pop_back();
+    }
+}
+
+template <Executor TExecutor>
+size_t ComputationalGraph<TExecutor>::runChain(size_t index, size_t completedNodesCount, std::vector<size_t> &inlined)
+{
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    nodeProfiles[index].dequeued = std::chrono::steady_clock::now();
+#endif
+    for(;; index = fusedNext(index))
+    {
+        ++completedNodesCount;
+        INode *node = planNodes[index];
+#ifdef COMPUTATIONALGRAPH_PROFILING
+        NodeProfile &nodeProfile = nodeProfiles[index];
+        nodeProfile.thread = profilingThreadIndex();
+        nodeProfile.start = std::chrono::steady_clock::now();
+#endif
+        // costs are measured only if they are used
+        bool measure = measureCosts && !fixedCosts[planIds[index]];
+        auto start = measure ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+        const TNodeRunner &runner = runners[planIds[index]];
+        if(node->isParallel() || runner)
+        {
+            // the task is continued by the thread which completes the node
+            INode::TDone done = [this, index, completedNodesCount, start]{
+#ifdef COMPUTATIONALGRAPH_PROFILING
+                finishProfile(index);
+#endif
+                if(trackMemory)
+                    onComputed(index);
+                if(start != std::chrono::steady_clock::time_point{})
+                    measureCost(index, start);
+                std::vector<size_t> inlined;
+                size_t nextIndex = fusedNext(index) != noNode ? runChain(fusedNext(index), completedNodesCount, inlined)
+                                                              : onComplete(index, completedNodesCount, inlined);
+                runTasks(nextIndex, inlined);
+            };
+            if(runner)
+                runner(*node, spawn, std::move(done));
+            else
+                node->runParallel(spawn, std::move(done));
+            return noNode;
+        }
+
+        node->run();
+#ifdef COMPUTATIONALGRAPH_PROFILING
+        finishProfile(index);
+#endif
+        if(trackMemory)
+            onComputed(index);
+        if(measure)
+            measureCost(index, start);
+        if(fusedNext(index) == noNode)
+            return onComplete(index, completedNodesCount, inlined);
+    }
+}
+
+template <Executor TExecutor>
+size_t ComputationalGraph<TExecutor>::onComplete(size_t completedIndex, size_t completedNodesCount,
+                                                 std::vector<size_t> &inlined)
+{
+    size_t nextIndex = noNode;
+    size_t inlinedCount = inlined.size();
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    auto readyTime = std::chrono::steady_clock::now();
+#endif
+    if(policy != SchedulingPolicy::Fifo)
+    {
+        // this thread continues with the most critical ready node, which is not necessarily a child
+        size_t readyCount = 0;
+        for(size_t j = outputsBegin[completedIndex]; j < outputsBegin[completedIndex + 1]; ++j)
+            if(!dirty[outputIndices[j]] && --pendingInputs[outputIndices[j]] == 0)
+            {
+#ifdef COMPUTATIONALGRAPH_PROFILING
+                nodeProfiles[outputIndices[j]].ready = readyTime;
+#endif
+                if(planExecutions[outputIndices[j]] == NodeExecution::Inline)
+                    inlined.push_back(outputIndices[j]);
+                else
+                {
+                    pushReady(outputIndices[j]);
+                    ++readyCount;
+                }
+            }
+        if(readyCount != 0)
+        {
+            nextIndex = popReady();
+            for(size_t k = 1; k < readyCount; ++k)
+                executor.submit([this]{runTask(popReady());});
+            // spawned nodes are never continued by this thread
+            if(planExecutions[nextIndex] == NodeExecution::Spawn)
+            {
+                submitNode(nextIndex);
+                nextIndex = noNode;
+            }
+        }
+    }
+    else
+        for(size_t j = outputsBegin[completedIndex]; j < outputsBegin[completedIndex + 1]; ++j)
+        {
+            size_t childIndex = outputIndices[j];
+            // the last computed input schedules the child, deferred children are still dirty and are skipped
+            if(!dirty[childIndex] && --pendingInputs[childIndex] == 0)
+            {
+#ifdef COMPUTATIONALGRAPH_PROFILING
+                nodeProfiles[childIndex].ready = readyTime;
+#endif
+                if(planExecutions[childIndex] == NodeExecution::Inline)
+                    inlined.push_back(childIndex);
+                else if(nextIndex == noNode && planExecutions[childIndex] == NodeExecution::Auto && isLocal(childIndex))
+                    nextIndex = childIndex;
+                else
+                    submitNode(childIndex);
+            }
+        }
+
+    // the run can not be finished while there is a child to continue with
+    if(nextIndex != noNode || inlined.size() != inlinedCount)
+    {
+        completedCount += completedNodesCount;
+        return nextIndex;
+    }
+
+    // scheduledCount is read before the increment, after the last one the next run may change it
+    size_t totalCount = scheduledCount;
+    // the flag is set under the lock, so run() can not return (and the graph can not be destroyed)
+    // before this thread is done with the condition variable
+    if(completedCount.fetch_add(completedNodesCount) + completedNodesCount == totalCount)
+        finishRun();
+    return noNode;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::setSchedulingPolicy(SchedulingPolicy policy_)
+{
+    policy = policy_;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::setNodeCost(size_t id, double cost)
+{
+    if(id >= costs.size())
+    {
+        costs.resize(id + 1, unknownCost);
+        fixedCosts.resize(id + 1, false);
+    }
+    fixedCosts[id] = cost >= 0;
+    costs[id] = cost >= 0 ? cost : unknownCost;
+}
+
+template <Executor TExecutor>
+double ComputationalGraph<TExecutor>::getNodeCost(size_t id) const
+{
+    return id < costs.size() && costs[id] != unknownCost ? costs[id] : 1.0;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::computeBottomLevels()
+{
+    // plan indices are in topological order, so outputs of a node are computed before it;
+    // nodes which are not recomputed by this run cost nothing
+    for(size_t i = plannedSize; i-- > 0;)
+    {
+        double level = 0;
+        for(size_t j = outputsBegin[i]; j < outputsBegin[i + 1]; ++j)
+            level = std::max(level, priorities[outputIndices[j]]);
+        priorities[i] = level + (dirty[i] ? getNodeCost(planIds[i]) : 0.0);
+    }
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::measureCost(size_t index, std::chrono::steady_clock::time_point start)
+{
+    // every node is run by one thread at a time, the next run reads the costs after all nodes are completed
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    double &cost = costs[planIds[index]];
+    cost = cost == unknownCost ? elapsed : cost + (elapsed - cost) / 4;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::pushReady(size_t index)
+{
+    // the priority is fixed while the node is in the heap
+    if(policy == SchedulingPolicy::MemoryAware)
+        priorities[index] = memoryPriority(index);
+    std::lock_guard lock(readyMutex);
+    readyHeap.push_back(index);
+    std::push_heap(readyHeap.begin(), readyHeap.end(), [this](size_t a, size_t b){
+        return priorities[a] < priorities[b];
     });
 }
 
-void ComputationalGraph::onComplete(size_t completedId)
+template <Executor TExecutor>
+size_t ComputationalGraph<TExecutor>::popReady()
 {
-    for(size_t childId : graph[completedId]->getOutputs())
+    std::lock_guard lock(readyMutex);
+    std::pop_heap(readyHeap.begin(), readyHeap.end(), [this](size_t a, size_t b){
+        return priorities[a] < priorities[b];
+    });
+    size_t index = readyHeap.back();
+    readyHeap.pop_back();
+    return index;
+}
+
+template <Executor TExecutor>
+double ComputationalGraph<TExecutor>::memoryPriority(size_t index) const
+{
+    // bytes of the inputs which the node reads the last, minus the bytes of its result in the last run
+    double released = -static_cast<double>(resultBytes[index]);
+    if(releaseResults)
+        for(size_t j = producersBegin[index]; j < producersBegin[index + 1]; ++j)
+        {
+            auto [producerIndex, connectionsCount] = producerEntries[j];
+            if(!graphOutputs[planIds[producerIndex]] && !keptResults[producerIndex] &&
+               pendingReaders[producerIndex].load(std::memory_order_relaxed) == connectionsCount)
+                released += static_cast<double>(resultBytes[producerIndex]);
+        }
+    return released;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::onComputed(size_t index)
+{
+    // the result is counted before the inputs are released, since both are alive at this moment
+    resultBytes[index] = planNodes[index]->getResultBytes();
+    addLiveBytes(resultBytes[index]);
+
+    for(size_t j = producersBegin[index]; j < producersBegin[index + 1]; ++j)
     {
-        bool expected = false;
-        if(graph[childId]->isReady() && isScheduled[childId].compare_exchange_weak(expected, true))
+        auto [producerIndex, connectionsCount] = producerEntries[j];
+        // the last reader sees the writes of the producer and of the other readers
+        if(pendingReaders[producerIndex].fetch_sub(connectionsCount, std::memory_order_acq_rel) != connectionsCount ||
+           !releaseResults || graphOutputs[planIds[producerIndex]] || keptResults[producerIndex])
+            continue;
+        planNodes[producerIndex]->releaseResult();
+        liveBytes.fetch_sub(resultBytes[producerIndex], std::memory_order_relaxed);
+    }
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::addLiveBytes(size_t bytes)
+{
+    size_t live = liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+    while(live > peak && !peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+    {}
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::setReleaseResults(bool release)
+{
+    releaseResults = release;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::markOutput(size_t id)
+{
+    if(id >= graphOutputs.size())
+        graphOutputs.resize(id + 1, false);
+    graphOutputs[id] = true;
+    liveTargetsStale = true;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::setInlineThreshold(double threshold)
+{
+    inlineThreshold = threshold;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::setNodeExecution(size_t id, NodeExecution execution)
+{
+    if(id >= executions.size())
+        executions.resize(id + 1, NodeExecution::Auto);
+    executions[id] = execution;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::setNodeDomain(size_t id, size_t domain)
+{
+    if(id >= domains.size())
+        domains.resize(id + 1, CpuTopology::anyDomain);
+    domains[id] = domain;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::setNodeRunner(size_t id, TNodeRunner runner)
+{
+    if(id >= runners.size())
+        runners.resize(id + 1);
+    runners[id] = std::move(runner);
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::submitNode(size_t index)
+{
+    if constexpr(requires {executor.submitTo(size_t{}, [this]{});})
+    {
+        size_t domain = domains[planIds[index]];
+        if(domain != CpuTopology::anyDomain)
+        {
+            executor.submitTo(domain, [index, this]{runTask(index);});
+            return;
+        }
+    }
+    executor.submit([index, this]{runTask(index);});
+}
+
+template <Executor TExecutor>
+bool ComputationalGraph<TExecutor>::isLocal(size_t index) const
+{
+    if constexpr(requires {executor.currentDomain(); executor.domainsCount();})
+    {
+        size_t domain = domains[planIds[index]];
+        return domain == CpuTopology::anyDomain || domain == executor.currentDomain() ||
+               domain >= executor.domainsCount();
+    }
+    else
+        return true;
+}
+
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::updateExecutions()
+{
+    // Auto is left for the nodes which are either continued by the thread or spawned
+    for(size_t i : dirtyIds)
+    {
+        NodeExecution execution = executions[planIds[i]];
+        if(execution == NodeExecution::Auto && inlineThreshold > 0)
         {
-            threadsPool.submit([childId, this]{graph[childId]->run(); onComplete(childId);});
+            double cost = costs[planIds[i]];
+            if(cost != unknownCost && cost < inlineThreshold)
+                execution = NodeExecution::Inline;
         }
+        planExecutions[i] = execution;
     }
+}
 
-    if(++completedCount == graph.size())
-        allCompleted.notify_one();
+#ifdef COMPUTATIONALGRAPH_PROFILING
+template <Executor TExecutor>
+void ComputationalGraph<TExecutor>::finishProfile(size_t index)
+{
+    NodeProfile &nodeProfile = nodeProfiles[index];
+    nodeProfile.end = std::chrono::steady_clock::now();
+    nodeProfile.fanOut = planNodes[index]->getFanOutTime();
+    // the fused consumer is ready as soon as the node is completed
+    if(fusedNext(index) != noNode)
+        nodeProfiles[fusedNext(index)].ready = nodeProfiles[fusedNext(index)].dequeued = nodeProfile.end;
 }
+#endif
 
 #endif //COMPUTATIONALGRAPH_CPP_COMPUTATIONALGRAPH_H
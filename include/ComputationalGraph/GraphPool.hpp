@@ -0,0 +1,408 @@
+#ifndef COMPUTATIONALGRAPH_GRAPHPOOL_HPP
+#define COMPUTATIONALGRAPH_GRAPHPOOL_HPP
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <deque>
+#include <exception>
+#include "Graph.hpp"
+
+
+/**
+ * @brief Pool of identical instances of the graph sharing one executor. Nodes keep the state of their run
+ * (inputs and results), so independent requests are computed concurrently by different instances
+ * and one right-sized executor serves all of them.
+ * @code
+ * struct Handles
+ * {
+ *     Node<int> *input;
+ *     Node<double, int> *output;
+ * };
+ * ThreadsPool<> executor(8);
+ * GraphPool<ThreadsPool<>, Handles> pool(executor, 16, [](auto &graph){
+ *     auto &input = graph.template addInput<int>();
+ *     return Handles{&input, &graph.template addNode<double, int>([](int x){return std::sqrt(x);}, input)};
+ * });
+ * std::future<double> result = pool.runAsync(
+ *     [](auto &graph, Handles &nodes){graph.setInput(nodes.input->getId(), 4);},
+ *     [](auto &, Handles &nodes){return *nodes.output->getResult();});
+ * @endcode
+ * @tparam TExecutor executor which runs the nodes.
+ * @tparam THandles what the builder returns, e.g. pointers to the nodes of the instance.
+ */
+template <Executor TExecutor, typename THandles>
+class GraphPool
+{
+public:
+    using TGraph = ComputationalGraph<TExecutor>;
+    using TBuilder = std::function<THandles(TGraph&)>;
+
+    /**
+     * @brief Exclusive access to an instance, it is returned to the pool when the lease is destroyed.
+     */
+    class Lease
+    {
+    public:
+        Lease(Lease &&lease) noexcept:
+            pool(std::exchange(lease.pool, nullptr)),
+            index(lease.index)
+        {}
+
+        Lease& operator=(Lease &&lease) noexcept
+        {
+            if(this != &lease)
+            {
+                release();
+                pool = std::exchange(lease.pool, nullptr);
+                index = lease.index;
+            }
+            return *this;
+        }
+
+        ~Lease()
+        {release();}
+
+        TGraph& graph()
+        {return *pool->instances[index].graph;}
+
+        THandles& handles()
+        {return pool->instances[index].handles;}
+
+        THandles* operator->()
+        {return &handles();}
+
+        /**
+         * @brief Returns the instance to the pool, the run started by runAsync must be completed.
+         */
+        void release()
+        {
+            if(pool)
+                std::exchange(pool, nullptr)->release(index);
+        }
+
+    private:
+        friend class GraphPool;
+
+        Lease(GraphPool *pool_, size_t index_):
+            pool(pool_),
+            index(index_)
+        {}
+
+        GraphPool *pool;
+        size_t index;
+    };
+
+    /**
+     * @brief Creates the instances.
+     * @param executor_ the executor, it must outlive the pool.
+     * @param instancesCount count of instances, it bounds the count of concurrent runs.
+     * @param build adds the nodes to the empty instance, it is called for every instance.
+     * @param arenaSize see ComputationalGraph constructor.
+     */
+    GraphPool(TExecutor &executor_, size_t instancesCount, const TBuilder &build, size_t arenaSize = 0);
+
+    /**
+     * @brief Waits until all instances are returned.
+     */
+    ~GraphPool();
+
+    GraphPool(const GraphPool&) = delete;
+    GraphPool& operator=(const GraphPool&) = delete;
+
+    /**
+     * @brief Takes a free instance, waits if all of them are taken.
+     */
+    Lease acquire();
+
+    /**
+     * @brief Takes a free instance if there is one.
+     */
+    std::optional<Lease> tryAcquire();
+
+    /**
+     * @brief Computes the request without blocking the caller (unless all instances are taken):
+     * takes an instance, sets it up and runs it asynchronously, the result is collected
+     * by the thread which completes the run and the instance is returned before the future is ready.
+     * @param setup called as setup(graph, handles) before the run, e.g. to set the inputs.
+     * @param collect called as collect(graph, handles) after the run, its result is the value of the future.
+     * @return future of the result of collect, it gets the exception thrown by collect.
+     */
+    template <class TSetup, class TCollect>
+    auto runAsync(TSetup &&setup, TCollect collect) -> std::future<std::invoke_result_t<TCollect&, TGraph&, THandles&>>;
+
+    /**
+     * @brief Runs the graph for every element of the batch with up to size() elements in flight, every one
+     * computed by its own instance: while the last nodes of one element run, the first nodes of the next ones
+     * are already computed, so the executor is kept busy instead of waiting for every element to complete.
+     * Inputs of the instances refer to the elements of forward ranges of lvalues, elements of other ranges
+     * are copied to the inputs.
+     * @tparam TBatch range of tuples, i-th element of a tuple is the value of the input with id inputsIds_[i].
+     * @param batch input sets.
+     * @param inputsIds_ ids of the input nodes, the same in every instance.
+     * @param collect called as collect(graph, handles) once the element is computed, by the thread which
+     * completes its run, so it may be called concurrently.
+     * @return results of collect for every element, in order of the batch.
+     * @throws std::runtime_error if there is no instance or an id is not an input of the right type,
+     * otherwise the first exception thrown by collect or by setting the inputs, after the elements in flight
+     * are completed.
+     */
+    template <std::ranges::input_range TBatch, class TCollect>
+    auto runBatch(const TBatch &batch,
+                  const std::array<size_t, std::tuple_size_v<std::ranges::range_value_t<TBatch>>> &inputsIds_,
+                  TCollect collect) -> std::vector<std::invoke_result_t<TCollect&, TGraph&, THandles&>>;
+
+    size_t size() const
+    {return instances.size();}
+
+private:
+    struct Instance
+    {
+        std::unique_ptr<TGraph> graph;
+        THandles handles;
+    };
+
+    size_t acquireIndex();
+    void release(size_t index);
+
+    template <typename T>
+    static InputNode<T>* getInputNode(TGraph &graph, size_t id);
+
+    std::vector<Instance> instances;
+    std::vector<size_t> freeInstances;
+    std::mutex mutex;
+    std::condition_variable available;
+};
+
+
+
+template<Executor TExecutor, typename THandles>
+GraphPool<TExecutor, THandles>::GraphPool(TExecutor &executor_, size_t instancesCount, const TBuilder &build,
+                                          size_t arenaSize)
+{
+    instances.reserve(instancesCount);
+    for(size_t i = 0; i < instancesCount; ++i)
+    {
+        auto graph = std::make_unique<TGraph>(executor_, arenaSize);
+        THandles handles = build(*graph);
+        instances.push_back({std::move(graph), std::move(handles)});
+        freeInstances.push_back(instancesCount - 1 - i);
+    }
+}
+
+template<Executor TExecutor, typename THandles>
+GraphPool<TExecutor, THandles>::~GraphPool()
+{
+    std::unique_lock lock(mutex);
+    available.wait(lock, [this]{
+        return freeInstances.size() == instances.size();
+    });
+}
+
+template<Executor TExecutor, typename THandles>
+size_t GraphPool<TExecutor, THandles>::acquireIndex()
+{
+    std::unique_lock lock(mutex);
+    available.wait(lock, [this]{
+        return !freeInstances.empty();
+    });
+    size_t index = freeInstances.back();
+    freeInstances.pop_back();
+    return index;
+}
+
+template<Executor TExecutor, typename THandles>
+typename GraphPool<TExecutor, THandles>::Lease GraphPool<TExecutor, THandles>::acquire()
+{
+    return Lease(this, acquireIndex());
+}
+
+template<Executor TExecutor, typename THandles>
+std::optional<typename GraphPool<TExecutor, THandles>::Lease> GraphPool<TExecutor, THandles>::tryAcquire()
+{
+    std::lock_guard lock(mutex);
+    if(freeInstances.empty())
+        return std::nullopt;
+    size_t index = freeInstances.back();
+    freeInstances.pop_back();
+    return Lease(this, index);
+}
+
+template<Executor TExecutor, typename THandles>
+void GraphPool<TExecutor, THandles>::release(size_t index)
+{
+    std::lock_guard lock(mutex);
+    freeInstances.push_back(index);
+    // both acquire and the destructor may wait
+    available.notify_all();
+}
+
+template<Executor TExecutor, typename THandles>
+template<class TSetup, class TCollect>
+auto GraphPool<TExecutor, THandles>::runAsync(TSetup &&setup, TCollect collect)
+    -> std::future<std::invoke_result_t<TCollect&, TGraph&, THandles&>>
+{
+    using TResult = std::invoke_result_t<TCollect&, TGraph&, THandles&>;
+
+    size_t index = acquireIndex();
+    Instance &instance = instances[index];
+    try
+    {
+        setup(*instance.graph, instance.handles);
+    }
+    catch(...)
+    {
+        release(index);
+        throw;
+    }
+
+    auto promise = std::make_shared<std::promise<TResult>>();
+    std::future<TResult> future = promise->get_future();
+    instance.graph->runAsync([this, index, promise, collect = std::move(collect)]() mutable {
+        Instance &instance = instances[index];
+        // the instance is returned before the future is ready, so the pool may be destroyed right after it
+        try
+        {
+            if constexpr(std::is_void_v<TResult>)
+            {
+                collect(*instance.graph, instance.handles);
+                release(index);
+                promise->set_value();
+            }
+            else
+            {
+                TResult result = collect(*instance.graph, instance.handles);
+                release(index);
+                promise->set_value(std::move(result));
+            }
+        }
+        catch(...)
+        {
+            release(index);
+            promise->set_exception(std::current_exception());
+        }
+    });
+    return future;
+}
+
+template<Executor TExecutor, typename THandles>
+template<typename T>
+InputNode<T>* GraphPool<TExecutor, THandles>::getInputNode(TGraph &graph, size_t id)
+{
+    auto inputNode = id < graph.size() ? dynamic_cast<InputNode<T>*>(&graph.getNode(id)) : nullptr;
+    if(inputNode == nullptr)
+        throw std::runtime_error("Bad input node");
+
+    return inputNode;
+}
+
+template<Executor TExecutor, typename THandles>
+template<std::ranges::input_range TBatch, class TCollect>
+auto GraphPool<TExecutor, THandles>::runBatch(const TBatch &batch,
+                                              const std::array<size_t, std::tuple_size_v<std::ranges::range_value_t<TBatch>>> &inputsIds_,
+                                              TCollect collect) -> std::vector<std::invoke_result_t<TCollect&, TGraph&, THandles&>>
+{
+    using TElement = std::ranges::range_value_t<TBatch>;
+    using TResult = std::invoke_result_t<TCollect&, TGraph&, THandles&>;
+    constexpr auto inputsSequence = std::make_index_sequence<std::tuple_size_v<TElement>>();
+    // elements of forward ranges of lvalues stay valid during the call, so they are not copied
+    constexpr bool bindElements = std::ranges::forward_range<const TBatch> &&
+                                  std::is_lvalue_reference_v<std::ranges::range_reference_t<const TBatch>>;
+
+    if(instances.empty())
+        throw std::runtime_error("Graph pool has no instances");
+
+    // input nodes of every instance are resolved once for the whole batch
+    auto resolve = [&inputsIds_] <size_t ...i> (TGraph &graph, std::index_sequence<i...>)
+    {
+        return std::tuple{getInputNode<std::tuple_element_t<i, TElement>>(graph, inputsIds_[i])...};
+    };
+    std::vector<decltype(resolve(*instances[0].graph, inputsSequence))> inputNodes;
+    inputNodes.reserve(instances.size());
+    for(auto &instance : instances)
+        inputNodes.push_back(resolve(*instance.graph, inputsSequence));
+
+    // slots of the deque are not moved by emplace_back, so the runs write to them while it grows
+    std::deque<std::optional<TResult>> slots;
+    std::mutex stateMutex;
+    std::condition_variable completed;
+    size_t pendingCount = 0;
+    std::exception_ptr error;
+
+    auto finish = [&](size_t index, std::exception_ptr exception)
+    {
+        if constexpr(bindElements)
+            std::apply([](auto* ...nodes){(nodes->getBinding().unbind() , ...);}, inputNodes[index]);
+        release(index);
+        // the state is destroyed once the caller sees no pending runs, so it is notified under the lock
+        std::lock_guard lock(stateMutex);
+        if(exception && !error)
+            error = exception;
+        if(--pendingCount == 0)
+            completed.notify_all();
+    };
+
+    for(auto it = std::ranges::begin(batch); it != std::ranges::end(batch); ++it)
+    {
+        {
+            std::lock_guard lock(stateMutex);
+            if(error)
+                break;
+            ++pendingCount;
+        }
+        // the count of free instances bounds the count of elements in flight
+        size_t index = acquireIndex();
+        Instance &instance = instances[index];
+        std::optional<TResult> *slot = &slots.emplace_back();
+        try
+        {
+            decltype(auto) element = *it;
+            [&inputNodes, &element, index] <size_t ...i> (std::index_sequence<i...>)
+            {
+                if constexpr(bindElements)
+                    (std::get<i>(inputNodes[index])->getBinding().bind(std::get<i>(element)) , ...);
+                else
+                    (std::get<i>(inputNodes[index])->getBinding().set(std::get<i>(element)) , ...);
+            }(inputsSequence);
+            for(size_t id : inputsIds_)
+                instance.graph->markDirty(id);
+
+            instance.graph->runAsync([this, index, slot, &collect, &finish]{
+                Instance &instance = instances[index];
+                std::exception_ptr exception;
+                try
+                {
+                    slot->emplace(collect(*instance.graph, instance.handles));
+                }
+                catch(...)
+                {
+                    exception = std::current_exception();
+                }
+                finish(index, exception);
+            });
+        }
+        catch(...)
+        {
+            finish(index, std::current_exception());
+        }
+    }
+
+    std::unique_lock lock(stateMutex);
+    completed.wait(lock, [&pendingCount]{
+        return pendingCount == 0;
+    });
+    if(error)
+        std::rethrow_exception(error);
+
+    std::vector<TResult> results;
+    results.reserve(slots.size());
+    for(auto &slot : slots)
+        results.push_back(std::move(*slot));
+    return results;
+}
+
+
+#endif //COMPUTATIONALGRAPH_GRAPHPOOL_HPP
@@ -0,0 +1,188 @@
+#ifndef COMPUTATIONALGRAPH_INLINEFUNCTION_HPP
+#define COMPUTATIONALGRAPH_INLINEFUNCTION_HPP
+
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <functional>
+
+
+template <typename TSignature, size_t capacity = 4 * sizeof(void*)>
+class InlineFunction;
+
+/**
+ * @brief Copyable wrapper of a callable, like std::function, with larger local storage.
+ * Callables which fit into capacity bytes and are nothrow movable are stored inside the object,
+ * so neither construction nor copying of such functions allocates memory
+ * (e.g. lambdas capturing a few references or a std::function itself). Others are stored on the heap.
+ * @tparam TResult result type.
+ * @tparam TArgs arguments types.
+ * @tparam capacity size of the local storage.
+ */
+template <typename TResult, typename ...TArgs, size_t capacity>
+class InlineFunction<TResult(TArgs...), capacity>
+{
+public:
+    InlineFunction() noexcept = default;
+
+    /**
+     * @brief Wraps the callable.
+     * @param f the callable :: TArgs... -> TResult.
+     */
+    template <typename F>
+        requires (!std::is_same_v<std::remove_cvref_t<F>, InlineFunction> &&
+                  std::is_invocable_r_v<TResult, std::decay_t<F>&, TArgs...>)
+    InlineFunction(F &&f);
+
+    InlineFunction(const InlineFunction &other);
+
+    InlineFunction(InlineFunction &&other) noexcept;
+
+    InlineFunction& operator=(const InlineFunction &other);
+
+    InlineFunction& operator=(InlineFunction &&other) noexcept;
+
+    ~InlineFunction();
+
+    TResult operator()(TArgs ...args) const;
+
+    explicit operator bool() const noexcept
+    {return vtable != nullptr;}
+
+private:
+    struct VTable
+    {
+        TResult (*call)(void *storage, TArgs&& ...args);
+        void (*copy)(void *dst, const void *src);
+        void (*move)(void *dst, void *src) noexcept;  // leaves src destroyed
+        void (*destroy)(void *storage) noexcept;
+    };
+
+    template <typename F>
+    static constexpr bool isLocal = sizeof(F) <= capacity && alignof(F) <= alignof(std::max_align_t) &&
+                                    std::is_nothrow_move_constructible_v<F>;
+
+    template <typename F>
+    static F* get(void *storage) noexcept
+    {
+        if constexpr(isLocal<F>)
+            return std::launder(static_cast<F*>(storage));
+        else
+            return *static_cast<F**>(storage);
+    }
+
+    template <typename F>
+    static constexpr VTable vtableFor{
+        [](void *storage, TArgs&& ...args) -> TResult {
+            return std::invoke(*get<F>(storage), std::forward<TArgs>(args)...);
+        },
+        [](void *dst, const void *src) {
+            const F &f = *get<F>(const_cast<void*>(src));
+            if constexpr(isLocal<F>)
+                ::new(dst) F(f);
+            else
+                *static_cast<F**>(dst) = new F(f);
+        },
+        [](void *dst, void *src) noexcept {
+            if constexpr(isLocal<F>)
+            {
+                ::new(dst) F(std::move(*get<F>(src)));
+                get<F>(src)->~F();
+            }
+            else
+                *static_cast<F**>(dst) = *static_cast<F**>(src);
+        },
+        [](void *storage) noexcept {
+            if constexpr(isLocal<F>)
+                get<F>(storage)->~F();
+            else
+                delete get<F>(storage);
+        }
+    };
+
+    alignas(std::max_align_t) mutable unsigned char storage[capacity];
+    const VTable *vtable = nullptr;
+};
+
+
+
+template <typename TResult, typename ...TArgs, size_t capacity>
+template <typename F>
+    requires (!std::is_same_v<std::remove_cvref_t<F>, InlineFunction<TResult(TArgs...), capacity>> &&
+              std::is_invocable_r_v<TResult, std::decay_t<F>&, TArgs...>)
+InlineFunction<TResult(TArgs...), capacity>::InlineFunction(F &&f)
+{
+    using TF = std::decay_t<F>;
+    if constexpr(isLocal<TF>)
+        ::new(static_cast<void*>(storage)) TF(std::forward<F>(f));
+    else
+        *reinterpret_cast<TF**>(storage) = new TF(std::forward<F>(f));
+    vtable = &vtableFor<TF>;
+}
+
+template <typename TResult, typename ...TArgs, size_t capacity>
+InlineFunction<TResult(TArgs...), capacity>::InlineFunction(const InlineFunction &other):
+    vtable(other.vtable)
+{
+    if(vtable)
+        vtable->copy(storage, other.storage);
+}
+
+template <typename TResult, typename ...TArgs, size_t capacity>
+InlineFunction<TResult(TArgs...), capacity>::InlineFunction(InlineFunction &&other) noexcept:
+    vtable(other.vtable)
+{
+    if(vtable)
+    {
+        vtable->move(storage, other.storage);
+        other.vtable = nullptr;
+    }
+}
+
+template <typename TResult, typename ...TArgs, size_t capacity>
+InlineFunction<TResult(TArgs...), capacity>& InlineFunction<TResult(TArgs...), capacity>::operator=(const InlineFunction &other)
+{
+    if(this != &other)
+    {
+        InlineFunction copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template <typename TResult, typename ...TArgs, size_t capacity>
+InlineFunction<TResult(TArgs...), capacity>& InlineFunction<TResult(TArgs...), capacity>::operator=(InlineFunction &&other) noexcept
+{
+    if(this != &other)
+    {
+        if(vtable)
+            vtable->destroy(storage);
+        vtable = other.vtable;
+        if(vtable)
+        {
+            vtable->move(storage, other.storage);
+            other.vtable = nullptr;
+        }
+    }
+    return *this;
+}
+
+template <typename TResult, typename ...TArgs, size_t capacity>
+InlineFunction<TResult(TArgs...), capacity>::~InlineFunction()
+{
+    if(vtable)
+        vtable->destroy(storage);
+}
+
+template <typename TResult, typename ...TArgs, size_t capacity>
+TResult InlineFunction<TResult(TArgs...), capacity>::operator()(TArgs ...args) const
+{
+    if(!vtable)
+        throw std::bad_function_call();
+    return vtable->call(storage, std::forward<TArgs>(args)...);
+}
+
+
+#endif //COMPUTATIONALGRAPH_INLINEFUNCTION_HPP
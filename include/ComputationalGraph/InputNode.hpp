@@ -0,0 +1,172 @@
+#ifndef COMPUTATIONALGRAPH_INPUTNODE_HPP
+#define COMPUTATIONALGRAPH_INPUTNODE_HPP
+
+#include <memory>
+#include <vector>
+#include <optional>
+#include "Node.hpp"
+
+
+/**
+ * @brief Value of the input read by InputNode: either its own copy or an object owned by the caller.
+ */
+template <typename T>
+struct InputBinding
+{
+    std::optional<T> value;
+    const T *source = nullptr;
+
+    /**
+     * @brief Copies (or moves) the value, the previous value is assigned, so its storage is reused.
+     */
+    template <typename TT>
+    void set(TT &&val)
+    {
+        if(value)
+            *value = std::forward<TT>(val);
+        else
+            value.emplace(std::forward<TT>(val));
+        source = &*value;
+    }
+
+    /**
+     * @brief Refers to the object without copying it, it must outlive the runs reading it.
+     */
+    void bind(const T &val)
+    {source = &val;}
+
+    /**
+     * @brief Refers to its own value again, the one set last (or to nothing if it was never set).
+     */
+    void unbind()
+    {source = value ? &*value : nullptr;}
+};
+
+
+/**
+ * @brief Storage of the bindings of all inputs of the graph. Bindings are placed one after another
+ * in chunks which are never moved, so the inputs read them by pointers and the table grows without copying.
+ */
+class InputBindingTable
+{
+public:
+    explicit InputBindingTable(size_t chunkSize_ = 16 << 10):
+        chunkSize(chunkSize_)
+    {}
+
+    ~InputBindingTable();
+
+    InputBindingTable(const InputBindingTable&) = delete;
+    InputBindingTable& operator=(const InputBindingTable&) = delete;
+
+    template <typename T>
+    InputBinding<T>& allocate();
+
+private:
+    struct Destructor
+    {
+        void *binding;
+        void (*destroy)(void *binding);
+    };
+
+    size_t chunkSize;
+    std::vector<std::unique_ptr<std::byte[]>> chunks;
+    size_t used = 0;
+    size_t currentSize = 0;
+    std::vector<Destructor> destructors;
+};
+
+
+/**
+ * @brief Input Node, it passes the value of its binding to the outputs without calling a function.
+ * If the binding is not set, it is computed by the function as any other Node<T>.
+ * @tparam T type of the input.
+ */
+template <typename T>
+class InputNode : public Node<T>
+{
+public:
+    using TNode = Node<T>;
+
+    InputNode(size_t id_, InputBinding<T> &binding_):
+        TNode(id_),
+        binding(&binding_)
+    {}
+
+    void run() override;
+
+    InputBinding<T>& getBinding() const
+    {return *binding;}
+
+protected:
+    InputBinding<T> *binding;
+};
+
+
+/**
+ * @brief Typed reference to the input of ComputationalGraph, which sets it without looking the node up.
+ * It is copyable and small, e.g. to keep thousands of them in a vector.
+ * @tparam T type of the input.
+ */
+template <typename T>
+class InputHandle
+{
+public:
+    InputHandle() = default;
+
+    InputHandle(InputNode<T> &node):
+        id(node.getId()),
+        binding(&node.getBinding())
+    {}
+
+    size_t getId() const
+    {return id;}
+
+    InputBinding<T>& getBinding() const
+    {return *binding;}
+
+private:
+    size_t id = 0;
+    InputBinding<T> *binding = nullptr;
+};
+
+
+
+inline InputBindingTable::~InputBindingTable()
+{
+    for(const Destructor &destructor : destructors)
+        destructor.destroy(destructor.binding);
+}
+
+template <typename T>
+InputBinding<T>& InputBindingTable::allocate()
+{
+    constexpr size_t size = sizeof(InputBinding<T>);
+    constexpr size_t alignment = alignof(InputBinding<T>);
+    size_t offset = (used + alignment - 1) / alignment * alignment;
+    if(chunks.empty() || offset + size > currentSize)
+    {
+        // operator new[] aligns to the fundamental alignment, larger ones are not supported
+        static_assert(alignment <= alignof(std::max_align_t), "Overaligned inputs are not supported");
+        currentSize = std::max(chunkSize, size);
+        chunks.emplace_back(new std::byte[currentSize]);
+        offset = 0;
+    }
+
+    auto binding = ::new(chunks.back().get() + offset) InputBinding<T>;
+    used = offset + size;
+    destructors.push_back({binding, [](void *b){static_cast<InputBinding<T>*>(b)->~InputBinding<T>();}});
+    return *binding;
+}
+
+template <typename T>
+void InputNode<T>::run()
+{
+    if(!binding->source)
+        return TNode::run();
+    TNode::result = *binding->source;
+    TNode::notifyOutputs();
+}
+
+
+#endif //COMPUTATIONALGRAPH_INPUTNODE_HPP
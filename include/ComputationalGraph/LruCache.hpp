@@ -0,0 +1,130 @@
+#ifndef COMPUTATIONALGRAPH_LRUCACHE_HPP
+#define COMPUTATIONALGRAPH_LRUCACHE_HPP
+
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <optional>
+
+
+/**
+ * @brief Thread safe bounded cache which evicts the least recently used element.
+ */
+template <typename TKey, typename TValue, typename THash = std::hash<TKey>>
+class LruCache
+{
+public:
+    /**
+     * @brief Creates empty cache.
+     * @param capacity_ maximal count of stored elements.
+     */
+    explicit LruCache(size_t capacity_);
+
+    /**
+     * @brief Looks up the value and marks it as the most recently used.
+     * @param key the key.
+     * @return copy of the value if it is found, empty otherwise.
+     */
+    std::optional<TValue> get(const TKey &key);
+
+    /**
+     * @brief Stores the value, the least recently used element is evicted if the cache is full.
+     * @param key the key.
+     * @param value the value.
+     */
+    template <typename TK, typename TV>
+    void put(TK &&key, TV &&value);
+
+    void clear();
+
+    size_t size() const;
+    size_t getCapacity() const
+    {return capacity;}
+
+    size_t getHits() const
+    {return hits;}
+    size_t getMisses() const
+    {return misses;}
+
+private:
+    using TEntry = std::pair<TKey, TValue>;
+
+    size_t capacity;
+    std::list<TEntry> entries;
+    std::unordered_map<TKey, typename std::list<TEntry>::iterator, THash> index;
+    mutable std::mutex cacheMutex;
+
+    std::atomic<size_t> hits;
+    std::atomic<size_t> misses;
+};
+
+
+template<typename TKey, typename TValue, typename THash>
+LruCache<TKey, TValue, THash>::LruCache(size_t capacity_):
+    capacity(capacity_),
+    hits(0),
+    misses(0)
+{
+    index.reserve(capacity);
+}
+
+template<typename TKey, typename TValue, typename THash>
+std::optional<TValue> LruCache<TKey, TValue, THash>::get(const TKey &key)
+{
+    std::lock_guard lock(cacheMutex);
+    auto it = index.find(key);
+    if(it == index.end())
+    {
+        ++misses;
+        return {};
+    }
+
+    ++hits;
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->second;
+}
+
+template<typename TKey, typename TValue, typename THash>
+template<typename TK, typename TV>
+void LruCache<TKey, TValue, THash>::put(TK &&key, TV &&value)
+{
+    if(capacity == 0)
+        return;
+
+    std::lock_guard lock(cacheMutex);
+    auto it = index.find(key);
+    if(it != index.end())
+    {
+        it->second->second = std::forward<TV>(value);
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+
+    if(entries.size() == capacity)
+    {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+
+    entries.emplace_front(std::forward<TK>(key), std::forward<TV>(value));
+    index.emplace(entries.front().first, entries.begin());
+}
+
+template<typename TKey, typename TValue, typename THash>
+void LruCache<TKey, TValue, THash>::clear()
+{
+    std::lock_guard lock(cacheMutex);
+    index.clear();
+    entries.clear();
+}
+
+template<typename TKey, typename TValue, typename THash>
+size_t LruCache<TKey, TValue, THash>::size() const
+{
+    std::lock_guard lock(cacheMutex);
+    return entries.size();
+}
+
+
+#endif //COMPUTATIONALGRAPH_LRUCACHE_HPP
@@ -0,0 +1,154 @@
+#ifndef COMPUTATIONALGRAPH_MPMCQUEUE_HPP
+#define COMPUTATIONALGRAPH_MPMCQUEUE_HPP
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <new>
+
+
+/**
+ * @brief Bounded lock free multi producer multi consumer FIFO queue (D. Vyukov's algorithm).
+ * Every cell has a sequence number which tells whether it is ready to be written or read,
+ * so producers and consumers only contend on their own position counter.
+ */
+template <typename T>
+class MPMCQueue
+{
+public:
+    /**
+     * @brief Creates empty queue.
+     * @param capacity_ the capacity, rounded up to the power of two.
+     */
+    explicit MPMCQueue(size_t capacity_ = 4096);
+    ~MPMCQueue();
+
+    MPMCQueue(const MPMCQueue&) = delete;
+    MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+    /**
+     * @brief Pushes value if the queue is not full.
+     * @param val the value, it is left untouched if the queue is full.
+     * @return true if the value was pushed.
+     */
+    template <typename TT>
+    bool tryPush(TT &&val);
+
+    std::optional<T> pop();
+
+    /**
+     * @brief Returns approximate count of elements.
+     */
+    size_t size() const;
+    bool empty() const;
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* get()
+        {return std::launder(reinterpret_cast<T*>(storage));}
+    };
+
+    size_t mask;
+    std::unique_ptr<Cell[]> cells;
+
+    alignas(64) std::atomic<size_t> enqueuePosition;
+    alignas(64) std::atomic<size_t> dequeuePosition;
+};
+
+
+template<typename T>
+MPMCQueue<T>::MPMCQueue(size_t capacity_):
+    enqueuePosition(0),
+    dequeuePosition(0)
+{
+    size_t capacity = 2;
+    while(capacity < capacity_)
+        capacity <<= 1;
+    mask = capacity - 1;
+
+    cells.reset(new Cell[capacity]);
+    for(size_t i = 0; i < capacity; ++i)
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template<typename T>
+MPMCQueue<T>::~MPMCQueue()
+{
+    while(pop())
+        ;
+}
+
+template<typename T>
+template<typename TT>
+bool MPMCQueue<T>::tryPush(TT &&val)
+{
+    Cell *cell;
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    while(true)
+    {
+        cell = &cells[position & mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+        if(diff == 0)
+        {
+            if(enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if(diff < 0)
+            return false;
+        else
+            position = enqueuePosition.load(std::memory_order_relaxed);
+    }
+
+    new (cell->storage) T(std::forward<TT>(val));
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename T>
+std::optional<T> MPMCQueue<T>::pop()
+{
+    Cell *cell;
+    size_t position = dequeuePosition.load(std::memory_order_relaxed);
+    while(true)
+    {
+        cell = &cells[position & mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+        if(diff == 0)
+        {
+            if(dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if(diff < 0)
+            return {};
+        else
+            position = dequeuePosition.load(std::memory_order_relaxed);
+    }
+
+    std::optional<T> val(std::move(*cell->get()));
+    cell->get()->~T();
+    cell->sequence.store(position + mask + 1, std::memory_order_release);
+    return val;
+}
+
+template<typename T>
+size_t MPMCQueue<T>::size() const
+{
+    size_t enqueued = enqueuePosition.load(std::memory_order_relaxed);
+    size_t dequeued = dequeuePosition.load(std::memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+template<typename T>
+bool MPMCQueue<T>::empty() const
+{
+    return size() == 0;
+}
+
+
+#endif //COMPUTATIONALGRAPH_MPMCQUEUE_HPP
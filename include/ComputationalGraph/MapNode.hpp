@@ -0,0 +1,231 @@
+#ifndef COMPUTATIONALGRAPH_MAPNODE_HPP
+#define COMPUTATIONALGRAPH_MAPNODE_HPP
+
+#include <atomic>
+#include <algorithm>
+#include "Node.hpp"
+
+
+/**
+ * @brief Base of the nodes processing the elements of the input array in parallel.
+ * The array is split into chunks of grainSize elements, every chunk is a separate job of the executor
+ * (the thread running the node takes the first one). The result is passed to the outputs
+ * by the thread which completes the last chunk. When the node is run outside of ComputationalGraph
+ * or the array fits into one chunk, the chunks are processed sequentially by the calling thread.
+ * @tparam TOutput type of output of the node.
+ * @tparam TInput type of elements of the input array.
+ */
+template <typename TOutput, typename TInput>
+class ChunkedNode : public Node<TOutput, std::vector<TInput>>
+{
+public:
+    using TNode = Node<TOutput, std::vector<TInput>>;
+
+    /**
+     * @brief Creates node with specified grain size.
+     * @param id_ Node's id.
+     * @param grainSize_ count of elements processed by one job.
+     */
+    ChunkedNode(size_t id_, size_t grainSize_);
+
+    /**
+     * @brief Sets count of elements processed by one job.
+     * Chunks should be large enough to amortize the submission of a job (thousands of cheap elements).
+     * @param grainSize_ the grain size, at least 1.
+     */
+    void setGrainSize(size_t grainSize_);
+
+    size_t getGrainSize() const
+    {return grainSize;}
+
+    void run() override;
+
+    bool isParallel() const override
+    {return true;}
+
+    void runParallel(const INode::TSpawn &spawn, INode::TDone done) override;
+
+protected:
+    /**
+     * @brief Called before the chunks are processed.
+     * @param input the input array.
+     * @param chunksCount count of the chunks.
+     */
+    virtual void beginChunks(const std::vector<TInput> &input, size_t chunksCount) = 0;
+
+    /**
+     * @brief Processes the elements [begin, end) of the input array, chunks are processed concurrently.
+     * @param chunk index of the chunk.
+     */
+    virtual void processChunk(const std::vector<TInput> &input, size_t chunk, size_t begin, size_t end) = 0;
+
+    /**
+     * @brief Called after all chunks are processed, sets the result.
+     */
+    virtual void endChunks(size_t chunksCount) = 0;
+
+    size_t chunksCountFor(size_t size) const
+    {return std::max<size_t>(1, (size + grainSize - 1) / grainSize);}
+
+    void runChunk(size_t chunk);
+
+    size_t grainSize;
+    size_t runningChunksCount = 0;
+    std::atomic<size_t> pendingChunks{0};
+    INode::TDone onDone;
+};
+
+
+/**
+ * @brief Node applying the function to every element of the input array in parallel,
+ * the results are written into the output array preallocated for the input size.
+ * The output may be folded by FoldNode, or use MapReduceNode to fold the mapped elements without the array.
+ * @code
+ * auto &squares = graph.addNode<MapNode, double, double>([](double x){return x * x;}, 4096, values);
+ * @endcode
+ * @tparam TOutput type of elements of the output array, it must be default constructible.
+ * @tparam TInput type of elements of the input array.
+ */
+template <typename TOutput, typename TInput>
+class MapNode : public ChunkedNode<std::vector<TOutput>, TInput>
+{
+public:
+    using TChunkedNode = ChunkedNode<std::vector<TOutput>, TInput>;
+    using TNode = typename TChunkedNode::TNode;
+    using TElementFunction = std::function<TOutput(const TInput&)>;
+
+    /**
+     * @brief Creates node with specified element function.
+     * @param id_ Node's id.
+     * @param func the element function func :: TInput -> TOutput, it is called concurrently.
+     * @param grainSize_ count of elements processed by one job.
+     */
+    MapNode(size_t id_, const TElementFunction &func, size_t grainSize_);
+
+    template<class ...TNodes>
+        requires (sizeof...(TNodes) > 0)
+    MapNode(size_t id_, const TElementFunction &func, size_t grainSize_, TNodes& ...nodes);
+
+protected:
+    void beginChunks(const std::vector<TInput> &input, size_t chunksCount) override;
+
+    void processChunk(const std::vector<TInput> &input, size_t chunk, size_t begin, size_t end) override;
+
+    void endChunks(size_t chunksCount) override;
+
+    // elements of std::vector<bool> share bytes, so they can not be written by different chunks
+    static_assert(!std::is_same_v<TOutput, bool>, "MapNode can not produce std::vector<bool>");
+
+    TElementFunction elementFunction;
+    std::vector<TOutput> buffer;
+};
+
+
+
+template<typename TOutput, typename TInput>
+ChunkedNode<TOutput, TInput>::ChunkedNode(size_t id_, size_t grainSize_):
+    TNode(id_),
+    grainSize(std::max<size_t>(1, grainSize_))
+{}
+
+template<typename TOutput, typename TInput>
+void ChunkedNode<TOutput, TInput>::setGrainSize(size_t grainSize_)
+{
+    grainSize = std::max<size_t>(1, grainSize_);
+}
+
+template<typename TOutput, typename TInput>
+void ChunkedNode<TOutput, TInput>::run()
+{
+    if(!TNode::isReady())
+        throw std::runtime_error("Some inputs are not initialized");
+
+    const auto &input = *std::get<0>(TNode::inputs);
+    size_t chunksCount = chunksCountFor(input.size());
+    beginChunks(input, chunksCount);
+    for(size_t chunk = 0; chunk < chunksCount; ++chunk)
+        processChunk(input, chunk, chunk * grainSize, std::min(input.size(), (chunk + 1) * grainSize));
+    endChunks(chunksCount);
+    TNode::notifyOutputs();
+}
+
+template<typename TOutput, typename TInput>
+void ChunkedNode<TOutput, TInput>::runParallel(const INode::TSpawn &spawn, INode::TDone done)
+{
+    if(!TNode::isReady())
+        throw std::runtime_error("Some inputs are not initialized");
+
+    const auto &input = *std::get<0>(TNode::inputs);
+    size_t chunksCount = chunksCountFor(input.size());
+    if(chunksCount == 1)
+    {
+        run();
+        done();
+        return;
+    }
+
+    beginChunks(input, chunksCount);
+    runningChunksCount = chunksCount;
+    onDone = std::move(done);
+    pendingChunks.store(chunksCount, std::memory_order_relaxed);
+    for(size_t chunk = 1; chunk < chunksCount; ++chunk)
+        spawn([this, chunk]{runChunk(chunk);});
+    runChunk(0);
+}
+
+template<typename TOutput, typename TInput>
+void ChunkedNode<TOutput, TInput>::runChunk(size_t chunk)
+{
+    const auto &input = *std::get<0>(TNode::inputs);
+    processChunk(input, chunk, chunk * grainSize, std::min(input.size(), (chunk + 1) * grainSize));
+
+    // the last chunk sees the writes of all others
+    if(pendingChunks.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        endChunks(runningChunksCount);
+        TNode::notifyOutputs();
+        // done may start the next run, which replaces onDone
+        INode::TDone done = std::move(onDone);
+        done();
+    }
+}
+
+
+template<typename TOutput, typename TInput>
+MapNode<TOutput, TInput>::MapNode(size_t id_, const TElementFunction &func, size_t grainSize_):
+    TChunkedNode(id_, grainSize_),
+    elementFunction(func)
+{}
+
+template<typename TOutput, typename TInput>
+template<class ...TNodes>
+    requires (sizeof...(TNodes) > 0)
+MapNode<TOutput, TInput>::MapNode(size_t id_, const TElementFunction &func, size_t grainSize_, TNodes& ...nodes):
+    MapNode(id_, func, grainSize_)
+{
+    TNode::connectAll(nodes...);
+}
+
+template<typename TOutput, typename TInput>
+void MapNode<TOutput, TInput>::beginChunks(const std::vector<TInput> &input, size_t)
+{
+    // chunks write disjoint ranges of the preallocated array, so they need no synchronization
+    buffer.resize(input.size());
+}
+
+template<typename TOutput, typename TInput>
+void MapNode<TOutput, TInput>::processChunk(const std::vector<TInput> &input, size_t, size_t begin, size_t end)
+{
+    for(size_t i = begin; i < end; ++i)
+        buffer[i] = elementFunction(input[i]);
+}
+
+template<typename TOutput, typename TInput>
+void MapNode<TOutput, TInput>::endChunks(size_t)
+{
+    TNode::result = std::move(buffer);
+    buffer = {};
+}
+
+
+#endif //COMPUTATIONALGRAPH_MAPNODE_HPP
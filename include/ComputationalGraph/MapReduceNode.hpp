@@ -0,0 +1,148 @@
+#ifndef COMPUTATIONALGRAPH_MAPREDUCENODE_HPP
+#define COMPUTATIONALGRAPH_MAPREDUCENODE_HPP
+
+#include "MapNode.hpp"
+#include "FoldNode.hpp"
+
+
+/**
+ * @brief Node applying the function to every element of the input array and folding the results in parallel,
+ * without materializing the mapped array. Every chunk is folded into its own partial result,
+ * partial results are combined in the order of chunks, as the associative fold of FoldNode.
+ * @code
+ * auto &norm2 = graph.addNode<MapReduceNode, double, double>([](double x){return x * x;}, Reduction::Sum{}, 4096, values);
+ * @endcode
+ * @tparam TOutput type of the mapped elements and of the result.
+ * @tparam TInput type of elements of the input array.
+ */
+template <typename TOutput, typename TInput>
+class MapReduceNode : public ChunkedNode<TOutput, TInput>
+{
+public:
+    using TChunkedNode = ChunkedNode<TOutput, TInput>;
+    using TNode = typename TChunkedNode::TNode;
+    using TElementFunction = std::function<TOutput(const TInput&)>;
+    using TCombineFunction = typename FoldNode<TOutput, TOutput>::TCombineFunction;
+
+    /**
+     * @brief Creates node with specified element function and fold.
+     * @param id_ Node's id.
+     * @param func the element function func :: TInput -> TOutput, it is called concurrently.
+     * @param combine the associative fold :: (TOutput, TOutput) -> TOutput.
+     * @param identity the identity element: combine(identity, x) == combine(x, identity) == x.
+     * @param grainSize_ count of elements processed by one job.
+     */
+    MapReduceNode(size_t id_, const TElementFunction &func, const TCombineFunction &combine, TOutput identity,
+                  size_t grainSize_);
+
+    template<class ...TNodes>
+        requires (sizeof...(TNodes) > 0)
+    MapReduceNode(size_t id_, const TElementFunction &func, const TCombineFunction &combine, TOutput identity,
+                  size_t grainSize_, TNodes& ...nodes);
+
+    /**
+     * @brief Creates node folding the mapped elements with the built-in reduction (e.g. Reduction::Sum).
+     * Mapped elements of a chunk are reduced by the vectorized kernel in blocks.
+     * @tparam TReduction the reduction.
+     * @param id_ Node's id.
+     * @param func the element function func :: TInput -> TOutput, it is called concurrently.
+     * @param grainSize_ count of elements processed by one job.
+     * @param nodes sequence of input Nodes.
+     */
+    template<class TReduction, class ...TNodes>
+        requires BuiltinReduction<TReduction, TOutput>
+    MapReduceNode(size_t id_, const TElementFunction &func, TReduction, size_t grainSize_, TNodes& ...nodes);
+
+protected:
+    void beginChunks(const std::vector<TInput> &input, size_t chunksCount) override;
+
+    void processChunk(const std::vector<TInput> &input, size_t chunk, size_t begin, size_t end) override;
+
+    void endChunks(size_t chunksCount) override;
+
+    static constexpr size_t blockSize = 256;
+
+    TElementFunction elementFunction;
+    TCombineFunction combineFunction;
+    TOutput identityValue;
+    std::vector<std::optional<TOutput>> partials;
+
+    // vectorized kernel of the built-in reduction
+    TOutput (*reduceArray)(const TOutput *data, size_t size, TOutput init) = nullptr;
+};
+
+
+
+template<typename TOutput, typename TInput>
+MapReduceNode<TOutput, TInput>::MapReduceNode(size_t id_, const TElementFunction &func, const TCombineFunction &combine,
+                                              TOutput identity, size_t grainSize_):
+    TChunkedNode(id_, grainSize_),
+    elementFunction(func),
+    combineFunction(combine),
+    identityValue(std::move(identity))
+{}
+
+template<typename TOutput, typename TInput>
+template<class ...TNodes>
+    requires (sizeof...(TNodes) > 0)
+MapReduceNode<TOutput, TInput>::MapReduceNode(size_t id_, const TElementFunction &func, const TCombineFunction &combine,
+                                              TOutput identity, size_t grainSize_, TNodes& ...nodes):
+    MapReduceNode(id_, func, combine, std::move(identity), grainSize_)
+{
+    TNode::connectAll(nodes...);
+}
+
+template<typename TOutput, typename TInput>
+template<class TReduction, class ...TNodes>
+    requires BuiltinReduction<TReduction, TOutput>
+MapReduceNode<TOutput, TInput>::MapReduceNode(size_t id_, const TElementFunction &func, TReduction, size_t grainSize_,
+                                              TNodes& ...nodes):
+    MapReduceNode(id_, func, &TReduction::template combine<TOutput>, TReduction::template identity<TOutput>(), grainSize_)
+{
+    reduceArray = &Reduction::reduce<TReduction, TOutput>;
+    if constexpr(sizeof...(TNodes) > 0)
+        TNode::connectAll(nodes...);
+}
+
+template<typename TOutput, typename TInput>
+void MapReduceNode<TOutput, TInput>::beginChunks(const std::vector<TInput> &, size_t chunksCount)
+{
+    partials.assign(chunksCount, std::nullopt);
+}
+
+template<typename TOutput, typename TInput>
+void MapReduceNode<TOutput, TInput>::processChunk(const std::vector<TInput> &input, size_t chunk, size_t begin, size_t end)
+{
+    TOutput partial = identityValue;
+    if constexpr(std::is_arithmetic_v<TOutput> && !std::is_same_v<TOutput, bool>)
+        if(reduceArray)
+        {
+            // mapped elements are buffered on the stack, so the kernel reads contiguous memory
+            TOutput block[blockSize];
+            for(size_t i = begin; i < end; i += blockSize)
+            {
+                size_t size = std::min(blockSize, end - i);
+                for(size_t k = 0; k < size; ++k)
+                    block[k] = elementFunction(input[i + k]);
+                partial = reduceArray(block, size, std::move(partial));
+            }
+            partials[chunk] = std::move(partial);
+            return;
+        }
+
+    for(size_t i = begin; i < end; ++i)
+        partial = combineFunction(std::move(partial), elementFunction(input[i]));
+    partials[chunk] = std::move(partial);
+}
+
+template<typename TOutput, typename TInput>
+void MapReduceNode<TOutput, TInput>::endChunks(size_t chunksCount)
+{
+    TOutput accumulator = identityValue;
+    for(size_t chunk = 0; chunk < chunksCount; ++chunk)
+        accumulator = combineFunction(std::move(accumulator), std::move(*partials[chunk]));
+    TNode::result = std::move(accumulator);
+}
+
+
+#endif //COMPUTATIONALGRAPH_MAPREDUCENODE_HPP
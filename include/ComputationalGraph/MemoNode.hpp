@@ -0,0 +1,116 @@
+#ifndef COMPUTATIONALGRAPH_MEMONODE_HPP
+#define COMPUTATIONALGRAPH_MEMONODE_HPP
+
+#include <memory>
+#include "Node.hpp"
+#include "LruCache.hpp"
+
+
+/**
+ * @brief Hash of the tuple combined from std::hash of its elements.
+ */
+template <typename ...Ts>
+struct TupleHash
+{
+    size_t operator()(const std::tuple<Ts...> &t) const
+    {
+        return std::apply([](const Ts& ...vs){
+            size_t seed = 0;
+            ((seed ^= std::hash<Ts>{}(vs) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2)) , ...);
+            return seed;
+        }, t);
+    }
+};
+
+
+/**
+ * @brief Node which caches results of the computation by the values of its inputs.
+ * The computation must be a pure function. Cache can be shared between nodes with the same computation,
+ * runs of the graph and different graphs.
+ */
+template <typename TOutput, typename ...TInputs>
+class MemoNode : public Node<TOutput, TInputs...>
+{
+public:
+    using TNode = Node<TOutput, TInputs...>;
+    using TFunction = typename TNode::TFunction;
+    using TKey = std::tuple<TInputs...>;
+    using TCache = LruCache<TKey, TOutput, TupleHash<TInputs...>>;
+
+    /**
+     * @brief Creates node with specified computation and shared cache.
+     * @param id_ Node's id.
+     * @param cache_ the cache.
+     * @param func the computation func :: TInputs... -> TOutput.
+     */
+    MemoNode(size_t id_, std::shared_ptr<TCache> cache_, const TFunction &func);
+
+    /**
+     * @brief Creates node with specified computation and its own cache.
+     * @param id_ Node's id.
+     * @param capacity count of cached results.
+     * @param func the computation func :: TInputs... -> TOutput.
+     */
+    MemoNode(size_t id_, size_t capacity, const TFunction &func);
+
+    /**
+     * @brief Creates node with specified computation, cache and inputs.
+     * @tparam TCacheArg either std::shared_ptr<TCache> or capacity of the new cache.
+     * @tparam TNodes variadic template for sequence of input Nodes.
+     * @param id_ Node's id.
+     * @param cacheArg the cache or its capacity.
+     * @param func the computation func :: TInputs... -> TOutput.
+     * @param nodes sequence of input Nodes.
+     */
+    template<class TCacheArg, class ...TNodes>
+        requires (sizeof...(TNodes) > 0)
+    MemoNode(size_t id_, TCacheArg &&cacheArg, const TFunction &func, TNodes& ...nodes);
+
+    void run() override;
+
+    std::shared_ptr<TCache> getCache() const
+    {return cache;}
+
+protected:
+    std::shared_ptr<TCache> cache;
+};
+
+
+template<typename TOutput, typename... TInputs>
+MemoNode<TOutput, TInputs...>::MemoNode(size_t id_, std::shared_ptr<TCache> cache_, const TFunction &func):
+    TNode(id_, func),
+    cache(std::move(cache_))
+{}
+
+template<typename TOutput, typename... TInputs>
+MemoNode<TOutput, TInputs...>::MemoNode(size_t id_, size_t capacity, const TFunction &func):
+    MemoNode(id_, std::make_shared<TCache>(capacity), func)
+{}
+
+template<typename TOutput, typename... TInputs>
+template<class TCacheArg, class ...TNodes>
+    requires (sizeof...(TNodes) > 0)
+MemoNode<TOutput, TInputs...>::MemoNode(size_t id_, TCacheArg &&cacheArg, const TFunction &func, TNodes& ...nodes):
+    MemoNode(id_, std::forward<TCacheArg>(cacheArg), func)
+{
+    TNode::connectAll(nodes...);
+}
+
+template<typename TOutput, typename... TInputs>
+void MemoNode<TOutput, TInputs...>::run()
+{
+    if(!TNode::isReady())
+        throw std::runtime_error("Some inputs are not initialized");
+
+    TKey key = std::apply([](TInputs* ...inputs1){return TKey{*inputs1...};}, TNode::inputs);
+    TNode::result = cache->get(key);
+    if(!TNode::result)
+    {
+        TNode::result = std::apply(TNode::function, key);
+        cache->put(std::move(key), *TNode::result);
+    }
+    TNode::notifyOutputs();
+}
+
+
+#endif //COMPUTATIONALGRAPH_MEMONODE_HPP
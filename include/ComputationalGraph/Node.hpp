@@ -3,16 +3,53 @@
 
 #include <iostream>
 #include <optional>
-#include <list>
+#include <vector>
+#include <span>
+#include <memory>
+#include <memory_resource>
 #include <array>
 #include <numeric>
 #include <functional>
 #include <atomic>
+#include <limits>
+#include <ranges>
+#include <algorithm>
+#include "InlineFunction.hpp"
+#include "Profiler.hpp"
+#include "Serializer.hpp"
+
+
+/**
+ * @brief Estimates the memory owned by the value: its size plus the elements of a contiguous container.
+ * It is found by argument dependent lookup, so it may be overloaded for types owning other memory.
+ * @param value the value.
+ * @return count of bytes.
+ */
+template <typename T>
+size_t estimateBytes(const T &value)
+{
+    if constexpr(std::ranges::contiguous_range<const T> && std::ranges::sized_range<const T>)
+        return sizeof(T) + std::ranges::size(value) * sizeof(std::ranges::range_value_t<const T>);
+    else
+        return sizeof(T);
+}
 
 
 class INode
 {
 public:
+    /**
+     * @brief Submits the job to the executor running the graph.
+     */
+    using TSpawn = InlineFunction<void(std::function<void()>)>;
+
+    /**
+     * @brief Called once the node computed its result and passed it to the outputs.
+     */
+    using TDone = InlineFunction<void()>;
+
+    virtual ~INode() = default;
+
     /**
      * @brief Checks whether all inputs are already computed or not
      * @return true if all inputs are computer, false otherwise.
@@ -25,6 +62,19 @@ public:
      */
     virtual void run() = 0;
 
+    /**
+     * @brief Returns node to the state it had before the first run.
+     * Connections and computation are kept, so the node can be run again.
+     */
+    virtual void reset() = 0;
+
+    /**
+     * @brief Passes already computed result to the output node again.
+     * Used to feed a recomputed node from the node which is not recomputed.
+     * @param outputId id of the output node.
+     */
+    virtual void emitTo(size_t outputId) = 0;
+
     /**
      * @brief Returns id of the node
      * @return the id.
@@ -33,9 +83,115 @@ public:
 
     /**
      * @brief Returns ids of output nodes.
-     * @return ids of the output nodes.
+     * @return view of ids of the output nodes, valid until the node is connected to another one.
+     */
+    virtual std::span<const size_t> getOutputs() const = 0;
+
+    /**
+     * @brief Moves storage of the node (e.g. its connections) to the memory resource.
+     * Called by ComputationalGraph right after the node is created.
+     * @param resource the memory resource, it must outlive the node.
+     */
+    virtual void setMemoryResource(std::pmr::memory_resource *resource) = 0;
+
+    /**
+     * @brief Checks whether the result of the last run was moved to the consumer.
+     * Such result can not be passed to the outputs again, so the node must be run again.
+     * @return true if the result was moved out.
+     */
+    virtual bool isResultReleased() const = 0;
+
+    /**
+     * @brief Destroys the result, or passes it to the recycler (see Node::setResultRecycler).
+     * Called by ComputationalGraph once all consumers have read the result.
+     * As after the result is moved out, the node must be run again before it is passed to the outputs.
+     */
+    virtual void releaseResult() = 0;
+
+    /**
+     * @brief Estimates the memory owned by the result, see estimateBytes.
+     * @return count of bytes, 0 if there is no result.
+     */
+    virtual size_t getResultBytes() const = 0;
+
+    /**
+     * @brief Checks whether the type of the result is Serializable (see Serializer.hpp).
+     */
+    virtual bool isResultSerializable() const = 0;
+
+    /**
+     * @brief Appends the result serialized by Serializer to the bytes.
+     * @return false if there is no result or it is not serializable.
+     */
+    virtual bool serializeResult(std::vector<std::byte> &bytes) const = 0;
+
+    /**
+     * @brief Sets the result deserialized from the bytes and passes it to the outputs, like run does.
+     * @return false if the result is not serializable or the bytes are not a serialized result.
+     */
+    virtual bool deserializeResult(std::span<const std::byte> bytes) = 0;
+
+    /**
+     * @brief Checks whether the node splits its computation into jobs (see runParallel).
+     * @return true if ComputationalGraph should call runParallel instead of run.
+     */
+    virtual bool isParallel() const
+    {return false;}
+
+    /**
+     * @brief Returns the key of the computation if it is declared pure (see Node::setPure).
+     * @return the key, 0 if the computation is not pure.
+     */
+    virtual uint64_t getFunctionKey() const
+    {return 0;}
+
+    /**
+     * @brief Returns ids of the nodes connected to the inputs, in order of the inputs.
+     * @return view of ids, an input which is not connected by connect has id max(size_t).
+     */
+    virtual std::span<const size_t> getProducers() const
+    {return {};}
+
+    /**
+     * @brief Moves the outputs of the duplicate (a node of the same type computing the same result) to this node,
+     * so its consumers are fed by this node. Used by ComputationalGraph::optimize.
+     * @param duplicate the duplicate, it is left without outputs.
+     * @return false if the outputs can not be moved, e.g. types of the nodes differ.
+     */
+    virtual bool adoptOutputs(INode &/*duplicate*/)
+    {return false;}
+
+    /**
+     * @brief Removes the outputs of this node to the consumer, so its result is no longer passed to it.
+     * Used by ComputationalGraph::optimize to disconnect merged duplicates from their producers.
+     * @param consumerId id of the consumer.
      */
-    virtual std::list<size_t> getOutputs() const = 0;
+    virtual void disconnectOutput(size_t consumerId) = 0;
+
+    /**
+     * @brief Runs this node, parts of the computation are submitted to the executor with spawn.
+     * The node is complete when done is called, possibly by another thread after this call returns.
+     * By default it just calls run and done.
+     * @param spawn submits the job, valid until done is called.
+     * @param done called once the result is passed to the outputs.
+     * @throws std::runtime_error if isReady() is false.
+     */
+    virtual void runParallel(const TSpawn &/*spawn*/, TDone done)
+    {
+        run();
+        done();
+    }
+
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    /**
+     * @brief Returns time spent by the last run in the callbacks of the outputs.
+     */
+    std::chrono::steady_clock::duration getFanOutTime() const
+    {return fanOutTime;}
+
+protected:
+    std::chrono::steady_clock::duration fanOutTime{};
+#endif
 };
 
 
@@ -50,8 +206,14 @@ public:
 
     /**
      * @brief Callback function type.
+     * Small callbacks (e.g. ones created by connect) are stored inline, without heap allocations.
+     */
+    using TCallback = InlineFunction<void(const TOutput &)>;
+
+    /**
+     * @brief Callback which takes the ownership of the result.
      */
-    using TCallback = std::function<void(const TOutput &)>;
+    using TMoveCallback = InlineFunction<void(TOutput &&)>;
 
     /**
      * @brief Creates empty node.
@@ -101,6 +263,10 @@ public:
 
     void run() override;
 
+    void reset() override;
+
+    void emitTo(size_t outputId) override;
+
     /**
      * @brief Callback for computer input.
      * @tparam inputNumber the number of computed input.
@@ -109,32 +275,146 @@ public:
     template<int inputNumber, typename T>
     void inputComputedCallback(T &&val);
 
+    /**
+     * @brief Records the producer of the input, called by connect.
+     * @tparam inputNumber the number of the input.
+     * @param producerId id of the producer.
+     */
+    template<int inputNumber>
+    void setProducer(size_t producerId);
+
     virtual std::optional<TOutput> getResult() const;
 
+    /**
+     * @brief Returns the result without copying it.
+     * @return reference to the result, valid until the next run or reset.
+     */
+    const std::optional<TOutput>& getResultRef() const;
+
+    /**
+     * @brief Moves the result out of the node.
+     * The node must be recomputed (e.g. marked dirty) before its result is used again.
+     * @return the result.
+     */
+    std::optional<TOutput> takeResult();
+
+    /**
+     * @brief Allows the last connected consumer to move the result instead of copying it
+     * (e.g. FoldNode collecting the values). After that the result of the node is empty
+     * and the graph runs the node again whenever the consumer is recomputed.
+     * The result is copied anyway while other consumers read it later by the pointer (see addReferencingCallback).
+     * Disabled by default.
+     * @param releasable whether the result may be moved.
+     */
+    void setResultReleasable(bool releasable);
+
+    bool isResultReleased() const override;
+
+    void releaseResult() override;
+
+    size_t getResultBytes() const override;
+
+    bool isResultSerializable() const override
+    {return Serializable<TOutput>;}
+
+    bool serializeResult(std::vector<std::byte> &bytes) const override;
+
+    bool deserializeResult(std::span<const std::byte> bytes) override;
+
+    /**
+     * @brief Sets the function which gets the result released by ComputationalGraph
+     * (see ComputationalGraph::setReleaseResults), e.g. to return its buffers to a pool.
+     * By default the result is destroyed.
+     * @param recycler the function.
+     */
+    void setResultRecycler(TMoveCallback recycler);
+
+    /**
+     * @brief Declares the computation pure: its result depends only on its inputs. Pure nodes of the same type
+     * with the same key and the same producers compute the same result, so ComputationalGraph::optimize
+     * merges them.
+     * @param functionKey_ key identifying the computation, e.g. a hash of its name, 0 means not pure.
+     */
+    void setPure(uint64_t functionKey_);
+
+    uint64_t getFunctionKey() const override
+    {return functionKey;}
+
+    std::span<const size_t> getProducers() const override
+    {return producers;}
+
+    bool adoptOutputs(INode &duplicate) override;
+
+    void disconnectOutput(size_t consumerId) override;
+
     size_t getId() const override;
 
-    std::list<size_t> getOutputs() const override;
+    std::span<const size_t> getOutputs() const override;
+
+    void setMemoryResource(std::pmr::memory_resource *resource) override;
 
     /**
      * @brief Adds callback which is called when node is computed.
      * @param callback the callback
      */
-    void addCallback(const TCallback &callback);
+    void addCallback(TCallback callback);
 
     /**
      * @brief Adds callback which is called when node is computed.
      * @param callback the callback
      * @param id_ id of node which is associated with output of the current node.
      */
-    void addCallback(const TCallback &callback, size_t id_);
+    void addCallback(TCallback callback, size_t id_);
+
+    /**
+     * @brief Adds callback which is called when node is computed.
+     * @param callback the callback
+     * @param id_ id of node which is associated with output of the current node.
+     * @param moveCallback the callback used instead of callback to move the result
+     * if it is the last one and the result is releasable.
+     */
+    void addCallback(TCallback callback, size_t id_, TMoveCallback moveCallback);
+
+    /**
+     * @brief Adds callback of the consumer which keeps the pointer to the result and reads it when it runs
+     * (e.g. the one created by connect). While the node has such consumers, its result is never moved out.
+     * @param callback the callback
+     * @param id_ id of node which is associated with output of the current node.
+     */
+    void addReferencingCallback(TCallback callback, size_t id_);
 
 protected:
+    struct OutputCallback
+    {
+        size_t id;
+        TCallback callback;
+        TMoveCallback moveCallback;
+        bool keepsReference = false;
+    };
+
+    /**
+     * @brief Calls all callbacks with the result.
+     */
+    void notifyOutputs();
+
+    /**
+     * @brief Recreates the vector with elements moved to the memory resource.
+     */
+    template <typename T>
+    static void rebind(std::pmr::vector<T> &vector, std::pmr::memory_resource *resource);
+
+    static constexpr size_t noOutput = std::numeric_limits<size_t>::max();
+
     std::optional<TOutput> result;
     std::tuple<TInputs*...> inputs;
-    std::list<size_t> outputs;
-    std::array<bool, sizeof...(TInputs)> inputsSet;
+    std::pmr::vector<size_t> outputs;
     TFunction function;
-    std::list<TCallback> outputCallbacks;
+    std::pmr::vector<OutputCallback> outputCallbacks;
+    TMoveCallback resultRecycler;
+    bool resultReleasable = false;
+    bool resultReleased = false;
+    uint64_t functionKey = 0;
+    std::array<size_t, sizeof...(TInputs)> producers;
 
     size_t id;
 };
@@ -143,18 +423,24 @@ protected:
 
 template<typename TOutput, typename ...TInputs>
 Node<TOutput, TInputs...>::Node(size_t id_):
+    inputs{},
     id(id_)
 {
-    std::for_each(inputsSet.begin(), inputsSet.end(), [](bool &v){v = false;});
+    producers.fill(noOutput);
 }
 
 template<typename TOutput, typename... TInputs>
 Node<TOutput, TInputs...>::Node(Node &&node) noexcept:
     result(std::move(node.result)),
     inputs(std::move(node.inputs)),
-    inputsSet(std::move(node.inputsSet)),
+    outputs(std::move(node.outputs)),
     function(std::move(node.function)),
     outputCallbacks(std::move(node.outputCallbacks)),
+    resultRecycler(std::move(node.resultRecycler)),
+    resultReleasable(node.resultReleasable),
+    resultReleased(node.resultReleased),
+    functionKey(node.functionKey),
+    producers(node.producers),
     id(node.id)
 {}
 
@@ -193,7 +479,8 @@ void Node<TOutput, TInputs...>::connectAll(TNodes& ...nodes)
 template<typename TOutput, typename ...TInputs>
 bool Node<TOutput, TInputs...>::isReady() const
 {
-    return std::accumulate(inputsSet.begin(), inputsSet.end(), true, std::logical_and());
+    // an input is set when its producer passed the pointer to its result
+    return std::apply([](TInputs* ...inputs1){return ((inputs1 != nullptr) && ...);}, inputs);
 }
 
 template<typename TOutput, typename... TInputs>
@@ -202,18 +489,67 @@ void Node<TOutput, TInputs...>::run()
     if(isReady())
     {
         result = std::apply([this](TInputs* ...inputs1){return function(*inputs1...);}, inputs);
-        std::for_each(outputCallbacks.begin(), outputCallbacks.end(), [this](auto callback){callback(*result);});
+        notifyOutputs();
     }
     else
         throw std::runtime_error("Some inputs are not initialized");
 }
 
+template<typename TOutput, typename... TInputs>
+void Node<TOutput, TInputs...>::reset()
+{
+    result.reset();
+    resultReleased = false;
+    inputs = {};
+}
+
+template<typename TOutput, typename... TInputs>
+void Node<TOutput, TInputs...>::emitTo(size_t outputId)
+{
+    for(const auto &output : outputCallbacks)
+        if(output.id == outputId)
+            output.callback(*result);
+}
+
+template<typename TOutput, typename... TInputs>
+void Node<TOutput, TInputs...>::notifyOutputs()
+{
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    auto fanOutStart = std::chrono::steady_clock::now();
+#endif
+    // the last consumer takes the result if it is allowed and no other consumer reads it later by the pointer
+    size_t copiesCount = outputCallbacks.size();
+    bool release = resultReleasable && copiesCount != 0 && outputCallbacks.back().moveCallback &&
+                   std::ranges::none_of(outputCallbacks, &OutputCallback::keepsReference);
+    if(release)
+        --copiesCount;
+
+    for(size_t i = 0; i < copiesCount; ++i)
+        outputCallbacks[i].callback(*result);
+
+    if(release)
+    {
+        resultReleased = true;
+        outputCallbacks.back().moveCallback(std::move(*result));
+        result.reset();
+    }
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    fanOutTime = std::chrono::steady_clock::now() - fanOutStart;
+#endif
+}
+
 template<typename TOutput, typename... TInputs>
 template<int inputNumber, typename T>
 void Node<TOutput, TInputs...>::inputComputedCallback(T &&val)
 {
     std::get<inputNumber>(inputs) = const_cast<std::remove_const_t<std::remove_reference_t<T>>*>(&val);
-    inputsSet[inputNumber] = true;
+}
+
+template<typename TOutput, typename... TInputs>
+template<int inputNumber>
+void Node<TOutput, TInputs...>::setProducer(size_t producerId)
+{
+    std::get<inputNumber>(producers) = producerId;
 }
 
 template<typename TOutput, typename... TInputs>
@@ -222,6 +558,116 @@ std::optional<TOutput> Node<TOutput, TInputs...>::getResult() const
     return result;
 }
 
+template<typename TOutput, typename... TInputs>
+const std::optional<TOutput>& Node<TOutput, TInputs...>::getResultRef() const
+{
+    return result;
+}
+
+template<typename TOutput, typename... TInputs>
+std::optional<TOutput> Node<TOutput, TInputs...>::takeResult()
+{
+    std::optional<TOutput> taken = std::move(result);
+    result.reset();
+    resultReleased = taken.has_value();
+    return taken;
+}
+
+template<typename TOutput, typename... TInputs>
+void Node<TOutput, TInputs...>::setResultReleasable(bool releasable)
+{
+    resultReleasable = releasable;
+}
+
+template<typename TOutput, typename... TInputs>
+bool Node<TOutput, TInputs...>::isResultReleased() const
+{
+    return resultReleased;
+}
+
+template<typename TOutput, typename... TInputs>
+void Node<TOutput, TInputs...>::releaseResult()
+{
+    if(result && resultRecycler)
+        resultRecycler(std::move(*result));
+    result.reset();
+    resultReleased = true;
+}
+
+template<typename TOutput, typename... TInputs>
+size_t Node<TOutput, TInputs...>::getResultBytes() const
+{
+    return result ? estimateBytes(*result) : 0;
+}
+
+template<typename TOutput, typename... TInputs>
+bool Node<TOutput, TInputs...>::serializeResult(std::vector<std::byte> &bytes) const
+{
+    if constexpr(Serializable<TOutput>)
+    {
+        if(!result)
+            return false;
+        size_t offset = bytes.size();
+        bytes.resize(offset + Serializer<TOutput>::size(*result));
+        Serializer<TOutput>::write(*result, std::span(bytes).subspan(offset));
+        return true;
+    }
+    else
+        return false;
+}
+
+template<typename TOutput, typename... TInputs>
+bool Node<TOutput, TInputs...>::deserializeResult(std::span<const std::byte> bytes)
+{
+    if constexpr(Serializable<TOutput>)
+    {
+        std::optional<TOutput> value = Serializer<TOutput>::read(bytes);
+        if(!value)
+            return false;
+        result = std::move(value);
+        resultReleased = false;
+        notifyOutputs();
+        return true;
+    }
+    else
+        return false;
+}
+
+template<typename TOutput, typename... TInputs>
+void Node<TOutput, TInputs...>::setResultRecycler(TMoveCallback recycler)
+{
+    resultRecycler = std::move(recycler);
+}
+
+template<typename TOutput, typename... TInputs>
+void Node<TOutput, TInputs...>::setPure(uint64_t functionKey_)
+{
+    functionKey = functionKey_;
+}
+
+template<typename TOutput, typename... TInputs>
+bool Node<TOutput, TInputs...>::adoptOutputs(INode &duplicate)
+{
+    auto node = dynamic_cast<Node*>(&duplicate);
+    if(node == nullptr || node == this)
+        return false;
+
+    // the callbacks refer to the consumers, not to the duplicate, so they are valid for this node
+    for(auto &output : node->outputCallbacks)
+        outputCallbacks.push_back(std::move(output));
+    outputs.insert(outputs.end(), node->outputs.begin(), node->outputs.end());
+    node->outputCallbacks.clear();
+    node->outputs.clear();
+    return true;
+}
+
+template<typename TOutput, typename... TInputs>
+void Node<TOutput, TInputs...>::disconnectOutput(size_t consumerId)
+{
+    std::erase_if(outputCallbacks, [consumerId](const OutputCallback &output){return output.id == consumerId;});
+    std::erase(outputs, consumerId);
+}
+
 template<typename TOutput, typename... TInputs>
 size_t Node<TOutput, TInputs...>::getId() const
 {
@@ -229,21 +675,51 @@ size_t Node<TOutput, TInputs...>::getId() const
 }
 
 template<typename TOutput, typename... TInputs>
-std::list<size_t> Node<TOutput, TInputs...>::getOutputs() const
+std::span<const size_t> Node<TOutput, TInputs...>::getOutputs() const
 {
     return outputs;
 }
 
 template<typename TOutput, typename... TInputs>
-void Node<TOutput, TInputs...>::addCallback(const TCallback &callback)
+void Node<TOutput, TInputs...>::setMemoryResource(std::pmr::memory_resource *resource)
+{
+    rebind(outputs, resource);
+    rebind(outputCallbacks, resource);
+}
+
+template<typename TOutput, typename... TInputs>
+template<typename T>
+void Node<TOutput, TInputs...>::rebind(std::pmr::vector<T> &vector, std::pmr::memory_resource *resource)
 {
-    outputCallbacks.push_back(callback);
+    // assignment keeps the allocator of the target, so the vector is constructed again
+    std::pmr::vector<T> rebound(std::make_move_iterator(vector.begin()), std::make_move_iterator(vector.end()), resource);
+    std::destroy_at(&vector);
+    std::construct_at(&vector, std::move(rebound));
+}
+
+template<typename TOutput, typename... TInputs>
+void Node<TOutput, TInputs...>::addCallback(TCallback callback)
+{
+    outputCallbacks.push_back({noOutput, std::move(callback), {}});
+}
+
+template<typename TOutput, typename... TInputs>
+void Node<TOutput, TInputs...>::addCallback(TCallback callback, size_t id_)
+{
+    addCallback(std::move(callback), id_, {});
+}
+
+template<typename TOutput, typename... TInputs>
+void Node<TOutput, TInputs...>::addCallback(TCallback callback, size_t id_, TMoveCallback moveCallback)
+{
+    outputCallbacks.push_back({id_, std::move(callback), std::move(moveCallback)});
+    outputs.push_back(id_);
 }
 
 template<typename TOutput, typename... TInputs>
-void Node<TOutput, TInputs...>::addCallback(const TCallback &callback, size_t id_)
+void Node<TOutput, TInputs...>::addReferencingCallback(TCallback callback, size_t id_)
 {
-    addCallback(callback);
+    outputCallbacks.push_back({id_, std::move(callback), {}, true});
     outputs.push_back(id_);
 }
 
@@ -251,9 +727,10 @@ void Node<TOutput, TInputs...>::addCallback(const TCallback &callback, size_t id
 template<int inputNumber, typename TOutput1, typename ...TInputs1, typename TOutput2, typename ...TInputs2>
 void connect(Node<TOutput1, TInputs1...> &a, Node<TOutput2, TInputs2...> &b)
 {
-    a.addCallback([&b](const TOutput1 &output){
+    a.addReferencingCallback([&b](const TOutput1 &output){
         b.template inputComputedCallback<inputNumber>(output);
     }, b.getId());
+    b.template setProducer<inputNumber>(a.getId());
 }
 
 
@@ -0,0 +1,179 @@
+#ifndef COMPUTATIONALGRAPH_PARTITIONER_HPP
+#define COMPUTATIONALGRAPH_PARTITIONER_HPP
+
+#include <vector>
+#include <numeric>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include "Graph.hpp"
+
+
+/**
+ * @brief Connection of two nodes weighted by the bytes sent over it if the nodes are in different parts.
+ */
+struct WeightedEdge
+{
+    size_t from;
+    size_t to;
+    double weight;
+};
+
+
+/**
+ * @brief Splits the nodes into parts of balanced weight with the minimal total weight of the cut edges.
+ * The nodes are assigned greedily in topological order (to the part holding the heaviest edges of the node,
+ * if it has room), then the assignment is refined by moving single nodes while it reduces the cut.
+ * @param nodeWeights weight of every node, e.g. its cost.
+ * @param edges the edges, ids of the nodes are indices in nodeWeights.
+ * @param partsCount count of parts.
+ * @param imbalance how much the weight of a part may exceed the average, e.g. 0.1 is 10%.
+ * @return part of every node.
+ */
+inline std::vector<size_t> partitionNodes(const std::vector<double> &nodeWeights, const std::vector<WeightedEdge> &edges,
+                                          size_t partsCount, double imbalance = 0.1)
+{
+    size_t nodesCount = nodeWeights.size();
+    if(partsCount == 0)
+        throw std::runtime_error("Count of parts must be positive");
+
+    // both directions of every edge, in CSR
+    std::vector<size_t> adjacencyBegin(nodesCount + 1, 0);
+    for(const auto &edge : edges)
+    {
+        ++adjacencyBegin[edge.from + 1];
+        ++adjacencyBegin[edge.to + 1];
+    }
+    std::partial_sum(adjacencyBegin.begin(), adjacencyBegin.end(), adjacencyBegin.begin());
+    std::vector<std::pair<size_t, double>> adjacency(adjacencyBegin[nodesCount]);
+    std::vector<size_t> adjacencyEnd(adjacencyBegin.begin(), adjacencyBegin.end() - 1);
+    std::vector<size_t> pending(nodesCount, 0);
+    for(const auto &edge : edges)
+    {
+        adjacency[adjacencyEnd[edge.from]++] = {edge.to, edge.weight};
+        adjacency[adjacencyEnd[edge.to]++] = {edge.from, edge.weight};
+        ++pending[edge.to];
+    }
+
+    // depth-first topological order, as in ComputationalGraph::prepare: a consumer usually follows
+    // its producer, so chains are placed in one part
+    std::vector<std::vector<size_t>> consumers(nodesCount);
+    for(const auto &edge : edges)
+        consumers[edge.from].push_back(edge.to);
+    std::vector<size_t> stack;
+    for(size_t id = nodesCount; id-- > 0;)
+        if(pending[id] == 0)
+            stack.push_back(id);
+    std::vector<size_t> order;
+    order.reserve(nodesCount);
+    while(!stack.empty())
+    {
+        size_t id = stack.back();
+        stack.pop_back();
+        order.push_back(id);
+        for(auto it = consumers[id].rbegin(); it != consumers[id].rend(); ++it)
+            if(--pending[*it] == 0)
+                stack.push_back(*it);
+    }
+    if(order.size() != nodesCount)
+        throw std::runtime_error("Graph has a cycle");
+
+    double totalWeight = std::accumulate(nodeWeights.begin(), nodeWeights.end(), 0.0);
+    double maxNodeWeight = nodesCount != 0 ? *std::max_element(nodeWeights.begin(), nodeWeights.end()) : 0;
+    // a part may always take one node, so the limit is reachable
+    double capacity = std::max(totalWeight / partsCount * (1 + imbalance), maxNodeWeight);
+
+    constexpr size_t noPart = std::numeric_limits<size_t>::max();
+    std::vector<size_t> parts(nodesCount, noPart);
+    std::vector<double> loads(partsCount, 0);
+    std::vector<double> connection(partsCount);
+    for(size_t id : order)
+    {
+        std::fill(connection.begin(), connection.end(), 0);
+        for(size_t j = adjacencyBegin[id]; j < adjacencyBegin[id + 1]; ++j)
+            if(parts[adjacency[j].first] != noPart)
+                connection[parts[adjacency[j].first]] += adjacency[j].second;
+
+        size_t best = noPart;
+        for(size_t part = 0; part < partsCount; ++part)
+        {
+            // the heaviest connection, then the lightest part
+            bool fits = loads[part] + nodeWeights[id] <= capacity;
+            if(fits && (best == noPart || connection[part] > connection[best] ||
+                        (connection[part] == connection[best] && loads[part] < loads[best])))
+                best = part;
+        }
+        if(best == noPart)
+            best = std::min_element(loads.begin(), loads.end()) - loads.begin();
+        parts[id] = best;
+        loads[best] += nodeWeights[id];
+    }
+
+    // every pass moves the nodes which have heavier edges to another part, while the part has room
+    constexpr size_t maxPasses = 8;
+    for(size_t pass = 0; pass < maxPasses; ++pass)
+    {
+        bool moved = false;
+        for(size_t id : order)
+        {
+            std::fill(connection.begin(), connection.end(), 0);
+            for(size_t j = adjacencyBegin[id]; j < adjacencyBegin[id + 1]; ++j)
+                connection[parts[adjacency[j].first]] += adjacency[j].second;
+
+            size_t current = parts[id];
+            size_t best = current;
+            for(size_t part = 0; part < partsCount; ++part)
+                if(part != current && connection[part] > connection[best] &&
+                   loads[part] + nodeWeights[id] <= capacity)
+                    best = part;
+            if(best != current)
+            {
+                loads[current] -= nodeWeights[id];
+                loads[best] += nodeWeights[id];
+                parts[id] = best;
+                moved = true;
+            }
+        }
+        if(!moved)
+            break;
+    }
+    return parts;
+}
+
+/**
+ * @brief Splits the nodes of the graph: nodes are weighted by their costs (see ComputationalGraph::getNodeCost),
+ * edges by the bytes of the results of their producers (see INode::getResultBytes), so the graph should be run
+ * once before to measure them. Nodes without results are weighted as one byte. Edges from the nodes without
+ * producers are not weighted, since they are computed by every host (see DistributedGraph).
+ * @param graph the graph.
+ * @param partsCount count of parts, e.g. of hosts.
+ * @param imbalance see partitionNodes.
+ * @return part of every node id.
+ */
+template <Executor TExecutor>
+std::vector<size_t> partitionGraph(const ComputationalGraph<TExecutor> &graph, size_t partsCount, double imbalance = 0.1)
+{
+    std::vector<double> nodeWeights(graph.size());
+    std::vector<char> hasProducers(graph.size(), false);
+    for(size_t id = 0; id < graph.size(); ++id)
+        for(size_t child : graph.getNode(id).getOutputs())
+            hasProducers[child] = true;
+
+    std::vector<WeightedEdge> edges;
+    for(size_t id = 0; id < graph.size(); ++id)
+    {
+        const INode &node = graph.getNode(id);
+        nodeWeights[id] = graph.getNodeCost(id);
+        double bytes = hasProducers[id] ? static_cast<double>(std::max<size_t>(node.getResultBytes(), 1)) : 0;
+        // a result is sent to the consumer once, however many times it is connected to the producer
+        std::vector<size_t> outputs(node.getOutputs().begin(), node.getOutputs().end());
+        std::sort(outputs.begin(), outputs.end());
+        outputs.erase(std::unique(outputs.begin(), outputs.end()), outputs.end());
+        for(size_t child : outputs)
+            edges.push_back({id, child, bytes});
+    }
+    return partitionNodes(nodeWeights, edges, partsCount, imbalance);
+}
+
+
+#endif //COMPUTATIONALGRAPH_PARTITIONER_HPP
@@ -0,0 +1,132 @@
+#ifndef COMPUTATIONALGRAPH_PROFILER_HPP
+#define COMPUTATIONALGRAPH_PROFILER_HPP
+
+// Instrumentation is compiled in only if COMPUTATIONALGRAPH_PROFILING is defined,
+// otherwise the graph and the pools contain no profiling code or data.
+#ifdef COMPUTATIONALGRAPH_PROFILING
+
+#include <chrono>
+#include <vector>
+#include <atomic>
+#include <ostream>
+#include <algorithm>
+
+
+/**
+ * @brief Counters of a worker of the pool since the pool was created.
+ */
+struct WorkerStats
+{
+    size_t jobsCount = 0;   // jobs run by the worker
+    size_t idleCount = 0;   // times the worker went to sleep without work
+    size_t stealsCount = 0; // jobs taken from other workers (WorkStealingPool)
+};
+
+
+/**
+ * @brief Counters of a worker updated by the worker itself and read by anyone.
+ */
+struct alignas(64) WorkerCounters
+{
+    std::atomic<size_t> jobsCount{0};
+    std::atomic<size_t> idleCount{0};
+    std::atomic<size_t> stealsCount{0};
+
+    void count(std::atomic<size_t> &counter)
+    {counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);}
+
+    WorkerStats load() const
+    {
+        return {jobsCount.load(std::memory_order_relaxed), idleCount.load(std::memory_order_relaxed),
+                stealsCount.load(std::memory_order_relaxed)};
+    }
+};
+
+
+/**
+ * @brief Timeline of the node in one run of ComputationalGraph.
+ */
+struct NodeProfile
+{
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    size_t id = 0;
+    size_t thread = 0;      // index of the thread which ran the node, see profilingThreadIndex
+    TimePoint ready;        // the last input was computed
+    TimePoint dequeued;     // a thread took the node
+    TimePoint start;
+    TimePoint end;          // the result was passed to the outputs
+    std::chrono::steady_clock::duration fanOut{};  // time spent in the output callbacks
+};
+
+
+/**
+ * @brief Profile of the last run of ComputationalGraph.
+ */
+struct RunProfile
+{
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+    std::vector<NodeProfile> nodes;     // nodes computed by the run, in topological order
+    std::vector<WorkerStats> workers;   // counters of the executor's workers, if it provides them
+
+    /**
+     * @brief Writes the profile in Chrome trace event format, which is opened by chrome://tracing and Perfetto.
+     * Every node is a complete event on the track of its thread, its wait in the queue is an async event.
+     * @param out the stream.
+     */
+    void writeChromeTrace(std::ostream &out) const;
+};
+
+
+/**
+ * @brief Returns small index of the calling thread, unique while the process is running.
+ */
+inline size_t profilingThreadIndex()
+{
+    static std::atomic<size_t> nextIndex{0};
+    thread_local size_t index = nextIndex++;
+    return index;
+}
+
+
+inline void RunProfile::writeChromeTrace(std::ostream &out) const
+{
+    auto us = [this](std::chrono::steady_clock::time_point t){
+        return std::chrono::duration<double, std::micro>(t - begin).count();
+    };
+
+    // tracks of the run and of the queue follow the tracks of the threads
+    size_t runTrack = 0;
+    for(const auto &node : nodes)
+        runTrack = std::max(runTrack, node.thread + 1);
+    size_t queueTrack = runTrack + 1;
+
+    out << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << runTrack << ",\"args\":{\"name\":\"run\"}},\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << queueTrack << ",\"args\":{\"name\":\"queue\"}},\n";
+    out << "{\"name\":\"run\",\"ph\":\"X\",\"pid\":0,\"tid\":" << runTrack << ",\"ts\":0,\"dur\":" << us(end) << "}";
+    for(const auto &node : nodes)
+    {
+        out << ",\n{\"name\":\"node " << node.id << "\",\"cat\":\"node\",\"ph\":\"X\",\"pid\":0,\"tid\":" << node.thread
+            << ",\"ts\":" << us(node.start) << ",\"dur\":" << us(node.end) - us(node.start)
+            << ",\"args\":{\"ready\":" << us(node.ready) << ",\"dequeued\":" << us(node.dequeued)
+            << ",\"fan_out\":" << std::chrono::duration<double, std::micro>(node.fanOut).count() << "}}";
+        // waits overlap, so they are async events
+        if(node.dequeued > node.ready)
+            out << ",\n{\"name\":\"wait\",\"cat\":\"queue\",\"ph\":\"b\",\"id\":" << node.id
+                << ",\"pid\":0,\"tid\":" << queueTrack << ",\"ts\":" << us(node.ready) << "}"
+                << ",\n{\"name\":\"wait\",\"cat\":\"queue\",\"ph\":\"e\",\"id\":" << node.id
+                << ",\"pid\":0,\"tid\":" << queueTrack << ",\"ts\":" << us(node.dequeued) << "}";
+    }
+    for(size_t i = 0; i < workers.size(); ++i)
+        out << ",\n{\"name\":\"worker " << i << "\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"ts\":" << us(end)
+            << ",\"args\":{\"jobs\":" << workers[i].jobsCount << ",\"idle\":" << workers[i].idleCount
+            << ",\"steals\":" << workers[i].stealsCount << "}}";
+    out << "\n]}\n";
+}
+
+#endif
+
+
+#endif //COMPUTATIONALGRAPH_PROFILER_HPP
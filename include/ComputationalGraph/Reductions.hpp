@@ -0,0 +1,361 @@
+#ifndef COMPUTATIONALGRAPH_REDUCTIONS_HPP
+#define COMPUTATIONALGRAPH_REDUCTIONS_HPP
+
+#include <cstddef>
+#include <limits>
+#include <concepts>
+#include <algorithm>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+/**
+ * @brief Built-in reductions recognized by FoldNode, e.g. FoldNode<float, float>(id, Reduction::Sum{}, nodes...).
+ * Arrays of values are reduced by kernels using the widest vector instructions enabled at compile time
+ * (AVX-512, AVX2 or NEON), otherwise by the scalar fallback.
+ * Values are combined in unspecified order, so floating point results may differ in the last bits
+ * from the sequential fold, handling of NaN by Min and Max is unspecified.
+ */
+namespace Reduction
+{
+    struct Sum
+    {
+        template <typename T>
+        static constexpr T identity()
+        {return T(0);}
+
+        template <typename T>
+        static T accumulate(T acc, T x)
+        {return acc + x;}
+
+        template <typename T>
+        static T combine(T a, T b)
+        {return a + b;}
+
+        template <class V>
+        static typename V::type step(typename V::type acc, typename V::type x)
+        {return V::add(acc, x);}
+
+        template <class V>
+        static typename V::type combineVectors(typename V::type a, typename V::type b)
+        {return V::add(a, b);}
+    };
+
+    struct Product
+    {
+        template <typename T>
+        static constexpr T identity()
+        {return T(1);}
+
+        template <typename T>
+        static T accumulate(T acc, T x)
+        {return acc * x;}
+
+        template <typename T>
+        static T combine(T a, T b)
+        {return a * b;}
+
+        template <class V>
+        static typename V::type step(typename V::type acc, typename V::type x)
+        {return V::mul(acc, x);}
+
+        template <class V>
+        static typename V::type combineVectors(typename V::type a, typename V::type b)
+        {return V::mul(a, b);}
+    };
+
+    struct Min
+    {
+        template <typename T>
+        static constexpr T identity()
+        {
+            if constexpr(std::numeric_limits<T>::has_infinity)
+                return std::numeric_limits<T>::infinity();
+            else
+                return std::numeric_limits<T>::max();
+        }
+
+        template <typename T>
+        static T accumulate(T acc, T x)
+        {return std::min(acc, x);}
+
+        template <typename T>
+        static T combine(T a, T b)
+        {return std::min(a, b);}
+
+        template <class V>
+        static typename V::type step(typename V::type acc, typename V::type x)
+        {return V::min(acc, x);}
+
+        template <class V>
+        static typename V::type combineVectors(typename V::type a, typename V::type b)
+        {return V::min(a, b);}
+    };
+
+    struct Max
+    {
+        template <typename T>
+        static constexpr T identity()
+        {
+            if constexpr(std::numeric_limits<T>::has_infinity)
+                return -std::numeric_limits<T>::infinity();
+            else
+                return std::numeric_limits<T>::lowest();
+        }
+
+        template <typename T>
+        static T accumulate(T acc, T x)
+        {return std::max(acc, x);}
+
+        template <typename T>
+        static T combine(T a, T b)
+        {return std::max(a, b);}
+
+        template <class V>
+        static typename V::type step(typename V::type acc, typename V::type x)
+        {return V::max(acc, x);}
+
+        template <class V>
+        static typename V::type combineVectors(typename V::type a, typename V::type b)
+        {return V::max(a, b);}
+    };
+
+    /**
+     * @brief Sum of squares of the inputs, i.e. the dot product of the inputs with themselves.
+     */
+    struct SumOfSquares
+    {
+        template <typename T>
+        static constexpr T identity()
+        {return T(0);}
+
+        template <typename T>
+        static T accumulate(T acc, T x)
+        {return acc + x * x;}
+
+        template <typename T>
+        static T combine(T a, T b)
+        {return a + b;}
+
+        template <class V>
+        static typename V::type step(typename V::type acc, typename V::type x)
+        {return V::add(acc, V::mul(x, x));}
+
+        template <class V>
+        static typename V::type combineVectors(typename V::type a, typename V::type b)
+        {return V::add(a, b);}
+    };
+
+
+    /**
+     * @brief One lane "vector", used by the fallback and for types without vector instructions.
+     */
+    template <typename T>
+    struct ScalarVector
+    {
+        using type = T;
+        static constexpr size_t width = 1;
+
+        static type set1(T v) {return v;}
+        static type load(const T *p) {return *p;}
+        static void store(T *p, type v) {*p = v;}
+        static type add(type a, type b) {return a + b;}
+        static type mul(type a, type b) {return a * b;}
+        static type min(type a, type b) {return std::min(a, b);}
+        static type max(type a, type b) {return std::max(a, b);}
+    };
+
+    template <typename T>
+    struct NativeVector
+    {
+        using type = ScalarVector<T>;
+    };
+
+#if defined(__AVX512F__)
+    struct Avx512Float
+    {
+        using type = __m512;
+        static constexpr size_t width = 16;
+
+        static type set1(float v) {return _mm512_set1_ps(v);}
+        static type load(const float *p) {return _mm512_loadu_ps(p);}
+        static void store(float *p, type v) {_mm512_storeu_ps(p, v);}
+        static type add(type a, type b) {return _mm512_add_ps(a, b);}
+        static type mul(type a, type b) {return _mm512_mul_ps(a, b);}
+        static type min(type a, type b) {return _mm512_min_ps(a, b);}
+        static type max(type a, type b) {return _mm512_max_ps(a, b);}
+    };
+
+    struct Avx512Double
+    {
+        using type = __m512d;
+        static constexpr size_t width = 8;
+
+        static type set1(double v) {return _mm512_set1_pd(v);}
+        static type load(const double *p) {return _mm512_loadu_pd(p);}
+        static void store(double *p, type v) {_mm512_storeu_pd(p, v);}
+        static type add(type a, type b) {return _mm512_add_pd(a, b);}
+        static type mul(type a, type b) {return _mm512_mul_pd(a, b);}
+        static type min(type a, type b) {return _mm512_min_pd(a, b);}
+        static type max(type a, type b) {return _mm512_max_pd(a, b);}
+    };
+
+    template <>
+    struct NativeVector<float>
+    {
+        using type = Avx512Float;
+    };
+
+    template <>
+    struct NativeVector<double>
+    {
+        using type = Avx512Double;
+    };
+#elif defined(__AVX2__)
+    struct Avx2Float
+    {
+        using type = __m256;
+        static constexpr size_t width = 8;
+
+        static type set1(float v) {return _mm256_set1_ps(v);}
+        static type load(const float *p) {return _mm256_loadu_ps(p);}
+        static void store(float *p, type v) {_mm256_storeu_ps(p, v);}
+        static type add(type a, type b) {return _mm256_add_ps(a, b);}
+        static type mul(type a, type b) {return _mm256_mul_ps(a, b);}
+        static type min(type a, type b) {return _mm256_min_ps(a, b);}
+        static type max(type a, type b) {return _mm256_max_ps(a, b);}
+    };
+
+    struct Avx2Double
+    {
+        using type = __m256d;
+        static constexpr size_t width = 4;
+
+        static type set1(double v) {return _mm256_set1_pd(v);}
+        static type load(const double *p) {return _mm256_loadu_pd(p);}
+        static void store(double *p, type v) {_mm256_storeu_pd(p, v);}
+        static type add(type a, type b) {return _mm256_add_pd(a, b);}
+        static type mul(type a, type b) {return _mm256_mul_pd(a, b);}
+        static type min(type a, type b) {return _mm256_min_pd(a, b);}
+        static type max(type a, type b) {return _mm256_max_pd(a, b);}
+    };
+
+    template <>
+    struct NativeVector<float>
+    {
+        using type = Avx2Float;
+    };
+
+    template <>
+    struct NativeVector<double>
+    {
+        using type = Avx2Double;
+    };
+#elif defined(__ARM_NEON)
+    struct NeonFloat
+    {
+        using type = float32x4_t;
+        static constexpr size_t width = 4;
+
+        static type set1(float v) {return vdupq_n_f32(v);}
+        static type load(const float *p) {return vld1q_f32(p);}
+        static void store(float *p, type v) {vst1q_f32(p, v);}
+        static type add(type a, type b) {return vaddq_f32(a, b);}
+        static type mul(type a, type b) {return vmulq_f32(a, b);}
+        static type min(type a, type b) {return vminq_f32(a, b);}
+        static type max(type a, type b) {return vmaxq_f32(a, b);}
+    };
+
+    template <>
+    struct NativeVector<float>
+    {
+        using type = NeonFloat;
+    };
+
+#if defined(__aarch64__)
+    struct NeonDouble
+    {
+        using type = float64x2_t;
+        static constexpr size_t width = 2;
+
+        static type set1(double v) {return vdupq_n_f64(v);}
+        static type load(const double *p) {return vld1q_f64(p);}
+        static void store(double *p, type v) {vst1q_f64(p, v);}
+        static type add(type a, type b) {return vaddq_f64(a, b);}
+        static type mul(type a, type b) {return vmulq_f64(a, b);}
+        static type min(type a, type b) {return vminq_f64(a, b);}
+        static type max(type a, type b) {return vmaxq_f64(a, b);}
+    };
+
+    template <>
+    struct NativeVector<double>
+    {
+        using type = NeonDouble;
+    };
+#endif
+#endif
+
+    /**
+     * @brief Reduces the array with the vector instructions V.
+     * Four independent accumulators hide the latency of the operation.
+     * @param data the array.
+     * @param size count of elements.
+     * @param init value the result of the array is combined with.
+     */
+    template <class TReduction, class V, typename T>
+    T reduceWith(const T *data, size_t size, T init)
+    {
+        constexpr size_t w = V::width;
+        auto a0 = V::set1(TReduction::template identity<T>()), a1 = a0, a2 = a0, a3 = a0;
+        size_t i = 0;
+        for(; i + 4 * w <= size; i += 4 * w)
+        {
+            a0 = TReduction::template step<V>(a0, V::load(data + i));
+            a1 = TReduction::template step<V>(a1, V::load(data + i + w));
+            a2 = TReduction::template step<V>(a2, V::load(data + i + 2 * w));
+            a3 = TReduction::template step<V>(a3, V::load(data + i + 3 * w));
+        }
+        for(; i + w <= size; i += w)
+            a0 = TReduction::template step<V>(a0, V::load(data + i));
+        a0 = TReduction::template combineVectors<V>(TReduction::template combineVectors<V>(a0, a1),
+                                                    TReduction::template combineVectors<V>(a2, a3));
+
+        T lanes[w];
+        V::store(lanes, a0);
+        T result = init;
+        for(T lane : lanes)
+            result = TReduction::combine(result, lane);
+        for(; i < size; ++i)
+            result = TReduction::accumulate(result, data[i]);
+        return result;
+    }
+
+    /**
+     * @brief Reduces the array with the widest vector instructions available for T.
+     */
+    template <class TReduction, typename T>
+    T reduce(const T *data, size_t size, T init)
+    {
+        return reduceWith<TReduction, typename NativeVector<T>::type>(data, size, init);
+    }
+}
+
+
+/**
+ * @brief Built-in reduction of values of type T, see namespace Reduction.
+ */
+template <typename TReduction, typename T>
+concept BuiltinReduction = std::is_arithmetic_v<T> && requires(T a, const T *data, size_t size)
+{
+    {TReduction::template identity<T>()} -> std::same_as<T>;
+    {TReduction::accumulate(a, a)} -> std::same_as<T>;
+    {TReduction::combine(a, a)} -> std::same_as<T>;
+    {Reduction::reduce<TReduction>(data, size, a)} -> std::same_as<T>;
+};
+
+
+#endif //COMPUTATIONALGRAPH_REDUCTIONS_HPP
@@ -0,0 +1,347 @@
+#ifndef COMPUTATIONALGRAPH_RESULTSTORE_HPP
+#define COMPUTATIONALGRAPH_RESULTSTORE_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Serializer.hpp"
+
+
+/**
+ * @brief Persistent cache of serialized results in a memory-mapped file, shared by the processes of the host.
+ * Entries are keyed by a stable key of the node and the hash of its inputs. They are appended and never changed,
+ * so lookups read the mapping without locks or system calls, and only insertion takes the lock of the file
+ * (flock, so it also excludes other processes). An entry is published after its bytes are written and is
+ * checked against its checksum on lookup, so entries torn by a crash are not loaded.
+ * The store has fixed capacity set by the process which creates the file; insertion into the full store fails,
+ * the file should be removed to start over.
+ * @code
+ * auto store = std::make_shared<ResultStore>("/var/cache/service/results.bin", 1ull << 30);
+ * constexpr uint64_t featuresKey = 2;  // changed with extractFeatures
+ * auto &features = graph.addNode<CachedNode, Features, Image>(store, featuresKey, extractFeatures, image);
+ * @endcode
+ */
+class ResultStore
+{
+public:
+    /**
+     * @brief Opens the file or creates it if it does not exist.
+     * @param path path of the file.
+     * @param dataCapacity_ bytes of the serialized results, used only if the file is created.
+     * @param slotsCount_ count of entries, used only if the file is created.
+     * @throws std::runtime_error if the file can not be opened, created or mapped, or it is not a store.
+     */
+    explicit ResultStore(const std::string &path, size_t dataCapacity_ = size_t(64) << 20, size_t slotsCount_ = 1 << 16);
+    ~ResultStore();
+
+    ResultStore(const ResultStore&) = delete;
+    ResultStore& operator=(const ResultStore&) = delete;
+
+    /**
+     * @brief Looks up the entry.
+     * @param key stable key of the node.
+     * @param inputsHash hash of the inputs, see hashValues.
+     * @return the bytes of the entry in the mapping, valid until the store is destroyed, empty if it is not found.
+     */
+    std::optional<std::span<const std::byte>> find(uint64_t key, uint64_t inputsHash) const;
+
+    /**
+     * @brief Adds the entry unless it is already stored.
+     * @param key stable key of the node.
+     * @param inputsHash hash of the inputs.
+     * @param size count of bytes of the entry.
+     * @param write called as write(bytes) to fill the bytes of the entry in the mapping.
+     * @return false if the store is full.
+     */
+    template <class TWrite>
+    bool insert(uint64_t key, uint64_t inputsHash, size_t size, TWrite &&write);
+
+    /**
+     * @brief Looks up the entry and deserializes it, an entry which is not a serialized T is a miss.
+     */
+    template <Serializable T>
+    std::optional<T> load(uint64_t key, uint64_t inputsHash) const;
+
+    /**
+     * @brief Serializes the value and adds it unless it is already stored.
+     * @return false if the store is full.
+     */
+    template <Serializable T>
+    bool store(uint64_t key, uint64_t inputsHash, const T &value);
+
+    /**
+     * @brief Returns count of entries, added by all processes.
+     */
+    size_t size() const
+    {return std::atomic_ref(header->usedSlots).load(std::memory_order_relaxed);}
+
+    size_t getSlotsCount() const
+    {return slotsCount;}
+
+    size_t getDataCapacity() const
+    {return dataCapacity;}
+
+    /**
+     * @brief Returns count of successful lookups of this process.
+     */
+    size_t getHits() const
+    {return hits;}
+
+    size_t getMisses() const
+    {return misses;}
+
+private:
+    static constexpr uint64_t magic = 0x5453524850414743ull;  // "CGAPHRST"
+    static constexpr uint64_t version = 1;
+    static constexpr uint64_t emptySlot = 0;
+    static constexpr uint64_t readySlot = 1;
+
+    struct Header
+    {
+        uint64_t magic;
+        uint64_t version;
+        uint64_t slotsCount;
+        uint64_t dataCapacity;
+        uint64_t usedSlots;
+        uint64_t dataUsed;
+    };
+
+    struct Slot
+    {
+        uint64_t state;  // published last, after the other fields and the bytes are written
+        uint64_t key;
+        uint64_t inputsHash;
+        uint64_t offset;
+        uint64_t size;
+        uint64_t checksum;
+    };
+
+    /**
+     * @brief flock of the file, which excludes other processes, and the mutex, which excludes threads
+     * sharing the descriptor.
+     */
+    class FileLock
+    {
+    public:
+        explicit FileLock(const ResultStore &store_);
+        ~FileLock();
+
+    private:
+        const ResultStore &store;
+    };
+
+    static size_t dataOffset(size_t slotsCount)
+    {return (sizeof(Header) + slotsCount * sizeof(Slot) + 63) / 64 * 64;}
+
+    size_t startSlot(uint64_t key, uint64_t inputsHash) const
+    {return (inputsHash ^ (key * 0x9e3779b97f4a7c15ull)) % slotsCount;}
+
+    /**
+     * @brief Looks up the entry like find, without counting the lookup.
+     */
+    std::optional<std::span<const std::byte>> lookup(uint64_t key, uint64_t inputsHash) const;
+
+    int file = -1;
+    size_t mappedSize = 0;
+    std::byte *mapping = nullptr;
+    Header *header = nullptr;
+    Slot *slots = nullptr;
+    std::byte *data = nullptr;
+    size_t slotsCount = 0;
+    size_t dataCapacity = 0;
+
+    mutable std::mutex insertMutex;
+    mutable std::atomic<size_t> hits{0};
+    mutable std::atomic<size_t> misses{0};
+};
+
+
+
+inline ResultStore::FileLock::FileLock(const ResultStore &store_):
+    store(store_)
+{
+    store.insertMutex.lock();
+    while(::flock(store.file, LOCK_EX) != 0)
+        if(errno != EINTR)
+        {
+            store.insertMutex.unlock();
+            throw std::runtime_error("Can not lock the result store");
+        }
+}
+
+inline ResultStore::FileLock::~FileLock()
+{
+    ::flock(store.file, LOCK_UN);
+    store.insertMutex.unlock();
+}
+
+inline ResultStore::ResultStore(const std::string &path, size_t dataCapacity_, size_t slotsCount_)
+{
+    file = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(file < 0)
+        throw std::runtime_error("Can not open the result store " + path);
+
+    try
+    {
+        // the process which creates the file initializes it, the others wait for the lock
+        FileLock lock(*this);
+        struct stat status;
+        if(::fstat(file, &status) != 0)
+            throw std::runtime_error("Can not stat the result store " + path);
+
+        Header existing{};
+        bool created = status.st_size == 0;
+        if(created)
+        {
+            if(slotsCount_ == 0)
+                throw std::runtime_error("Result store must have slots");
+            slotsCount = slotsCount_;
+            dataCapacity = dataCapacity_;
+            mappedSize = dataOffset(slotsCount) + dataCapacity;
+            // the blocks are allocated now, writes to a sparse mapping would crash when the disk is full
+            if(::posix_fallocate(file, 0, static_cast<off_t>(mappedSize)) != 0)
+                throw std::runtime_error("Can not allocate the result store " + path);
+        }
+        else
+        {
+            if(::pread(file, &existing, sizeof(existing), 0) != static_cast<ssize_t>(sizeof(existing)) ||
+               existing.magic != magic || existing.version != version || existing.slotsCount == 0)
+                throw std::runtime_error(path + " is not a result store");
+            slotsCount = existing.slotsCount;
+            dataCapacity = existing.dataCapacity;
+            mappedSize = dataOffset(slotsCount) + dataCapacity;
+            if(static_cast<size_t>(status.st_size) != mappedSize)
+                throw std::runtime_error(path + " is not a result store");
+        }
+
+        void *address = ::mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if(address == MAP_FAILED)
+            throw std::runtime_error("Can not map the result store " + path);
+        mapping = static_cast<std::byte*>(address);
+        header = reinterpret_cast<Header*>(mapping);
+        slots = reinterpret_cast<Slot*>(mapping + sizeof(Header));
+        data = mapping + dataOffset(slotsCount);
+
+        // the file is zeroed by fallocate, so all slots are empty
+        if(created)
+            *header = {magic, version, slotsCount, dataCapacity, 0, 0};
+    }
+    catch(...)
+    {
+        if(mapping)
+            ::munmap(mapping, mappedSize);
+        ::close(file);
+        throw;
+    }
+}
+
+inline ResultStore::~ResultStore()
+{
+    // dirty pages are written back by the kernel after the mapping is removed
+    ::munmap(mapping, mappedSize);
+    ::close(file);
+}
+
+inline std::optional<std::span<const std::byte>> ResultStore::find(uint64_t key, uint64_t inputsHash) const
+{
+    auto bytes = lookup(key, inputsHash);
+    if(bytes)
+        ++hits;
+    else
+        ++misses;
+    return bytes;
+}
+
+inline std::optional<std::span<const std::byte>> ResultStore::lookup(uint64_t key, uint64_t inputsHash) const
+{
+    size_t start = startSlot(key, inputsHash);
+    for(size_t i = 0; i < slotsCount; ++i)
+    {
+        Slot &slot = slots[(start + i) % slotsCount];
+        // the slots are never emptied, so the probe ends at the first empty one
+        if(std::atomic_ref(slot.state).load(std::memory_order_acquire) == emptySlot)
+            break;
+        if(slot.key != key || slot.inputsHash != inputsHash)
+            continue;
+
+        if(slot.offset > dataCapacity || slot.size > dataCapacity - slot.offset)
+            break;
+        std::span<const std::byte> bytes(data + slot.offset, slot.size);
+        if(fnv1a(bytes) != slot.checksum)
+            break;
+        return bytes;
+    }
+    return {};
+}
+
+template <class TWrite>
+bool ResultStore::insert(uint64_t key, uint64_t inputsHash, size_t size, TWrite &&write)
+{
+    FileLock lock(*this);
+    auto usedSlots = std::atomic_ref(header->usedSlots);
+    auto dataUsed = std::atomic_ref(header->dataUsed);
+
+    // probes stay short while a quarter of the slots is empty
+    if(usedSlots.load(std::memory_order_relaxed) + 1 > slotsCount - slotsCount / 4)
+        return false;
+    size_t offset = (dataUsed.load(std::memory_order_relaxed) + 15) / 16 * 16;
+    if(offset > dataCapacity || size > dataCapacity - offset)
+        return false;
+
+    size_t start = startSlot(key, inputsHash);
+    for(size_t i = 0; i < slotsCount; ++i)
+    {
+        Slot &slot = slots[(start + i) % slotsCount];
+        if(std::atomic_ref(slot.state).load(std::memory_order_relaxed) == emptySlot)
+        {
+            std::span<std::byte> bytes(data + offset, size);
+            write(bytes);
+            slot.key = key;
+            slot.inputsHash = inputsHash;
+            slot.offset = offset;
+            slot.size = size;
+            slot.checksum = fnv1a(bytes);
+            std::atomic_ref(slot.state).store(readySlot, std::memory_order_release);
+            usedSlots.store(usedSlots.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            dataUsed.store(offset + size, std::memory_order_relaxed);
+            return true;
+        }
+        // another thread or process has already stored it
+        if(slot.key == key && slot.inputsHash == inputsHash)
+            return true;
+    }
+    return false;
+}
+
+template <Serializable T>
+std::optional<T> ResultStore::load(uint64_t key, uint64_t inputsHash) const
+{
+    std::optional<T> value;
+    if(auto bytes = lookup(key, inputsHash))
+        value = Serializer<T>::read(*bytes);
+    if(value)
+        ++hits;
+    else
+        ++misses;
+    return value;
+}
+
+template <Serializable T>
+bool ResultStore::store(uint64_t key, uint64_t inputsHash, const T &value)
+{
+    return insert(key, inputsHash, Serializer<T>::size(value), [&value](std::span<std::byte> bytes){
+        Serializer<T>::write(value, bytes);
+    });
+}
+
+
+#endif //COMPUTATIONALGRAPH_RESULTSTORE_HPP
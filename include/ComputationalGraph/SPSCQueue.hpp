@@ -0,0 +1,146 @@
+#ifndef COMPUTATIONALGRAPH_SPSCQUEUE_HPP
+#define COMPUTATIONALGRAPH_SPSCQUEUE_HPP
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
+
+
+/**
+ * @brief Bounded lock free single producer single consumer FIFO queue (ring buffer).
+ * One thread at a time may push and one thread at a time may pop, the threads may change
+ * if the change is synchronized (e.g. the next job of the node runs after the previous one).
+ * The producer caches the position of the consumer, so it reads the consumer's counter only when
+ * the cached value says the queue is full.
+ */
+template <typename T>
+class SPSCQueue
+{
+public:
+    /**
+     * @brief Creates empty queue.
+     * @param capacity_ the capacity, rounded up to the power of two.
+     */
+    explicit SPSCQueue(size_t capacity_);
+    ~SPSCQueue();
+
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    /**
+     * @brief Pushes value if the queue is not full. Called by the producer.
+     * @param val the value, it is left untouched if the queue is full.
+     * @return true if the value was pushed.
+     */
+    template <typename TT>
+    bool tryPush(TT &&val);
+
+    /**
+     * @brief Returns the oldest element, the queue must not be empty. Called by the consumer.
+     */
+    T& front();
+
+    /**
+     * @brief Removes the oldest element, the queue must not be empty. Called by the consumer.
+     */
+    void pop();
+
+    /**
+     * @brief Approximate state, exact for the producer (full) and for the consumer (empty).
+     */
+    bool empty() const;
+    bool full() const;
+    size_t size() const;
+
+    size_t capacity() const
+    {return mask + 1;}
+
+private:
+    struct Cell
+    {
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* get()
+        {return std::launder(reinterpret_cast<T*>(storage));}
+    };
+
+    size_t mask;
+    std::unique_ptr<Cell[]> cells;
+
+    alignas(64) std::atomic<size_t> head;   // next position to pop
+    alignas(64) std::atomic<size_t> tail;   // next position to push
+    size_t cachedHead = 0;                  // head seen by the producer the last time
+};
+
+
+template<typename T>
+SPSCQueue<T>::SPSCQueue(size_t capacity_):
+    head(0),
+    tail(0)
+{
+    size_t capacity = 2;
+    while(capacity < capacity_)
+        capacity <<= 1;
+    mask = capacity - 1;
+    cells.reset(new Cell[capacity]);
+}
+
+template<typename T>
+SPSCQueue<T>::~SPSCQueue()
+{
+    for(size_t i = head.load(std::memory_order_relaxed), end = tail.load(std::memory_order_relaxed); i != end; ++i)
+        cells[i & mask].get()->~T();
+}
+
+template<typename T>
+template<typename TT>
+bool SPSCQueue<T>::tryPush(TT &&val)
+{
+    size_t position = tail.load(std::memory_order_relaxed);
+    if(position - cachedHead > mask)
+    {
+        cachedHead = head.load(std::memory_order_acquire);
+        if(position - cachedHead > mask)
+            return false;
+    }
+
+    ::new(static_cast<void*>(cells[position & mask].get())) T(std::forward<TT>(val));
+    tail.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename T>
+T& SPSCQueue<T>::front()
+{
+    return *cells[head.load(std::memory_order_relaxed) & mask].get();
+}
+
+template<typename T>
+void SPSCQueue<T>::pop()
+{
+    size_t position = head.load(std::memory_order_relaxed);
+    cells[position & mask].get()->~T();
+    head.store(position + 1, std::memory_order_release);
+}
+
+template<typename T>
+bool SPSCQueue<T>::empty() const
+{
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+}
+
+template<typename T>
+bool SPSCQueue<T>::full() const
+{
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire) > mask;
+}
+
+template<typename T>
+size_t SPSCQueue<T>::size() const
+{
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+}
+
+
+#endif //COMPUTATIONALGRAPH_SPSCQUEUE_HPP
@@ -0,0 +1,131 @@
+#ifndef COMPUTATIONALGRAPH_SERIALIZER_HPP
+#define COMPUTATIONALGRAPH_SERIALIZER_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include <type_traits>
+
+
+/**
+ * @brief Opt-in conversion of values to bytes and back, e.g. to persist results of nodes in ResultStore.
+ * Specializations provide:
+ * - static size_t size(const T &value): count of bytes of the value;
+ * - static void write(const T &value, std::span<std::byte> bytes): writes exactly size(value) bytes;
+ * - static std::optional<T> read(std::span<const std::byte> bytes): restores the value from the bytes written by write,
+ *   std::nullopt if the bytes can not be written by write (e.g. their size is wrong for the type).
+ * The bytes must not depend on the process (no pointers), so they can be read by another process.
+ * Trivially copyable types (without padding, which is not initialized), std::vector of them and std::string
+ * are supported.
+ * @tparam T type of the value.
+ */
+template <typename T>
+struct Serializer;
+
+template <typename T>
+concept Serializable = requires(const T &value, std::span<std::byte> out, std::span<const std::byte> in)
+{
+    {Serializer<T>::size(value)} -> std::convertible_to<size_t>;
+    Serializer<T>::write(value, out);
+    {Serializer<T>::read(in)} -> std::same_as<std::optional<T>>;
+};
+
+
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+struct Serializer<T>
+{
+    static size_t size(const T&)
+    {return sizeof(T);}
+
+    static void write(const T &value, std::span<std::byte> bytes)
+    {std::memcpy(bytes.data(), &value, sizeof(T));}
+
+    static std::optional<T> read(std::span<const std::byte> bytes)
+    {
+        if(bytes.size() != sizeof(T))
+            return std::nullopt;
+        T value;
+        std::memcpy(&value, bytes.data(), sizeof(T));
+        return value;
+    }
+};
+
+template <typename T, typename TAllocator>
+    requires std::is_trivially_copyable_v<T>
+struct Serializer<std::vector<T, TAllocator>>
+{
+    static size_t size(const std::vector<T, TAllocator> &value)
+    {return value.size() * sizeof(T);}
+
+    static void write(const std::vector<T, TAllocator> &value, std::span<std::byte> bytes)
+    {
+        if(!value.empty())
+            std::memcpy(bytes.data(), value.data(), value.size() * sizeof(T));
+    }
+
+    static std::optional<std::vector<T, TAllocator>> read(std::span<const std::byte> bytes)
+    {
+        if(bytes.size() % sizeof(T) != 0)
+            return std::nullopt;
+        std::vector<T, TAllocator> value(bytes.size() / sizeof(T));
+        if(!value.empty())
+            std::memcpy(value.data(), bytes.data(), value.size() * sizeof(T));
+        return value;
+    }
+};
+
+template <>
+struct Serializer<std::string>
+{
+    static size_t size(const std::string &value)
+    {return value.size();}
+
+    static void write(const std::string &value, std::span<std::byte> bytes)
+    {std::memcpy(bytes.data(), value.data(), value.size());}
+
+    static std::optional<std::string> read(std::span<const std::byte> bytes)
+    {return std::string(reinterpret_cast<const char*>(bytes.data()), bytes.size());}
+};
+
+
+/**
+ * @brief FNV-1a hash of the bytes, it is the same in every process and on every run.
+ * @param bytes the bytes.
+ * @param hash hash of the preceding bytes, to hash a sequence of chunks.
+ */
+inline uint64_t fnv1a(std::span<const std::byte> bytes, uint64_t hash = 0xcbf29ce484222325ull)
+{
+    for(std::byte b : bytes)
+    {
+        hash ^= static_cast<uint64_t>(b);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief Hashes the serialized values by fnv1a, sizes are hashed too, so ("ab", "c") differs from ("a", "bc").
+ */
+template <Serializable ...Ts>
+uint64_t hashValues(const Ts& ...values)
+{
+    // the buffer is reused by all calls of the thread
+    thread_local std::vector<std::byte> buffer;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto hashOne = [&hash]<typename T>(const T &value){
+        uint64_t size = Serializer<T>::size(value);
+        buffer.resize(size);
+        Serializer<T>::write(value, buffer);
+        hash = fnv1a(std::as_bytes(std::span(&size, 1)), hash);
+        hash = fnv1a(buffer, hash);
+    };
+    (hashOne(values), ...);
+    return hash;
+}
+
+
+#endif //COMPUTATIONALGRAPH_SERIALIZER_HPP
@@ -0,0 +1,367 @@
+#ifndef COMPUTATIONALGRAPH_STATICGRAPH_HPP
+#define COMPUTATIONALGRAPH_STATICGRAPH_HPP
+
+#include <tuple>
+#include <array>
+#include <optional>
+#include <latch>
+#include <functional>
+#include <type_traits>
+#include <algorithm>
+#include "Executor.hpp"
+
+
+/**
+ * @brief Input of the StaticGraph, its value is set with StaticGraph::setInput.
+ * @tparam index_ index of the input, inputs of a graph are numbered from 0.
+ * @tparam T type of the value.
+ */
+template <size_t index_, typename T>
+struct StaticInput
+{
+    using type = T;
+    static constexpr size_t index = index_;
+    static constexpr size_t level = 0;
+};
+
+
+/**
+ * @brief Node of the StaticGraph. The node is identified by its type,
+ * so the same type used as a dependency of several nodes is computed once.
+ * @tparam function the computation, e.g. captureless lambda or pointer to function.
+ * It is called with the results of dependencies.
+ * @tparam TDeps nodes whose results are the arguments of the function (StaticInput or StaticNode).
+ */
+template <auto function, class ...TDeps>
+struct StaticNode
+{
+    using type = std::decay_t<std::invoke_result_t<decltype(function), const typename TDeps::type&...>>;
+    static constexpr size_t level = 1 + std::max({size_t{0}, TDeps::level...});
+
+    static type compute(const typename TDeps::type& ...args)
+    {
+        return std::invoke(function, args...);
+    }
+};
+
+
+namespace StaticGraphDetail
+{
+    template <class ...Ts>
+    struct TypeList
+    {
+        static constexpr size_t size = sizeof...(Ts);
+    };
+
+    template <class T, class TList>
+    struct Contains;
+
+    template <class T, class ...Ts>
+    struct Contains<T, TypeList<Ts...>> : std::bool_constant<(std::is_same_v<T, Ts> || ...)> {};
+
+    template <class T, class TList>
+    struct IndexOf;
+
+    template <class T, class ...Ts>
+    struct IndexOf<T, TypeList<Ts...>>
+    {
+        static constexpr size_t value = []{
+            constexpr std::array<bool, sizeof...(Ts)> matches{std::is_same_v<T, Ts>...};
+            return static_cast<size_t>(std::find(matches.begin(), matches.end(), true) - matches.begin());
+        }();
+        static_assert(value < sizeof...(Ts), "Node is not a part of the graph");
+    };
+
+    template <class TNode>
+    struct Dependencies
+    {
+        using type = TypeList<>;
+    };
+
+    template <auto function, class ...TDeps>
+    struct Dependencies<StaticNode<function, TDeps...>>
+    {
+        using type = TypeList<TDeps...>;
+    };
+
+    template <class TNode>
+    struct IsInput : std::false_type {};
+
+    template <size_t index, typename T>
+    struct IsInput<StaticInput<index, T>> : std::true_type {};
+
+    template <class TNode, size_t index>
+    constexpr bool isInputWithIndex = false;
+
+    template <size_t nodeIndex, typename T, size_t index>
+    constexpr bool isInputWithIndex<StaticInput<nodeIndex, T>, index> = nodeIndex == index;
+
+    template <size_t index, class TList>
+    struct InputPosition;
+
+    template <size_t index, class ...Ts>
+    struct InputPosition<index, TypeList<Ts...>>
+    {
+        static constexpr size_t value = []{
+            constexpr std::array<bool, sizeof...(Ts)> matches{isInputWithIndex<Ts, index>...};
+            return static_cast<size_t>(std::find(matches.begin(), matches.end(), true) - matches.begin());
+        }();
+        static_assert(value < sizeof...(Ts), "Input with this index is not a part of the graph");
+        static_assert(((isInputWithIndex<Ts, index> ? 1 : 0) + ... + 0) == 1, "Inputs must have unique indices");
+    };
+
+    template <class TList, class TNode>
+    struct Append;
+
+    template <class ...Ts, class TNode>
+    struct Append<TypeList<Ts...>, TNode>
+    {
+        using type = TypeList<Ts..., TNode>;
+    };
+
+    // post-order depth-first traversal, every node is placed after all its dependencies
+    template <class TVisited, class TNodesList>
+    struct VisitList;
+
+    template <class TVisited, class TNode, bool visited = Contains<TNode, TVisited>::value>
+    struct Visit
+    {
+        using type = TVisited;
+    };
+
+    template <class TVisited, class TNode>
+    struct Visit<TVisited, TNode, false>
+    {
+        using type = typename Append<typename VisitList<TVisited, typename Dependencies<TNode>::type>::type, TNode>::type;
+    };
+
+    template <class TVisited>
+    struct VisitList<TVisited, TypeList<>>
+    {
+        using type = TVisited;
+    };
+
+    template <class TVisited, class TNode, class ...TNodes>
+    struct VisitList<TVisited, TypeList<TNode, TNodes...>>
+    {
+        using type = typename VisitList<typename Visit<TVisited, TNode>::type, TypeList<TNodes...>>::type;
+    };
+
+    template <class TList>
+    struct Results;
+
+    template <class ...Ts>
+    struct Results<TypeList<Ts...>>
+    {
+        using type = std::tuple<std::optional<typename Ts::type>...>;
+    };
+
+    template <class TList>
+    struct ToTuple;
+
+    template <class ...Ts>
+    struct ToTuple<TypeList<Ts...>>
+    {
+        using type = std::tuple<Ts...>;
+    };
+
+    template <class TList>
+    struct InputsCount;
+
+    template <class ...Ts>
+    struct InputsCount<TypeList<Ts...>>
+    {
+        static constexpr size_t value = ((IsInput<Ts>::value ? 1 : 0) + ... + 0);
+    };
+}
+
+
+/**
+ * @brief Computational graph described by types. Topological order and wiring of the nodes
+ * are computed at compile time, the evaluator calls computations directly, without virtual calls,
+ * std::function and dynamic_cast. The graph consists of the outputs and all nodes they depend on.
+ * @code
+ * using In = StaticInput<0, int>;
+ * using Sqr = StaticNode<[](int x){return x*x;}, In>;
+ * using Sqrt = StaticNode<[](int x){return std::sqrt(x);}, In>;
+ * using Sum = StaticNode<[](int a, double b){return a + b;}, Sqr, Sqrt>;
+ * StaticGraph<Sum> graph;
+ * double value = graph.evaluate(10);
+ * @endcode
+ * @tparam TOutputs nodes whose results are returned by evaluate.
+ */
+template <class ...TOutputs>
+class StaticGraph
+{
+public:
+    using TNodes = typename StaticGraphDetail::VisitList<StaticGraphDetail::TypeList<>,
+                                                         StaticGraphDetail::TypeList<TOutputs...>>::type;
+    static constexpr size_t nodesCount = TNodes::size;
+    static constexpr size_t inputsCount = StaticGraphDetail::InputsCount<TNodes>::value;
+
+    /**
+     * @brief Sets the value of the input.
+     * @tparam index index of the input.
+     * @param val the value.
+     */
+    template <size_t index, typename T>
+    void setInput(T &&val);
+
+    /**
+     * @brief Computes all nodes one after another in topological order. All inputs must be set.
+     */
+    void run();
+
+    /**
+     * @brief Computes the graph level by level, independent nodes of the same level are run in parallel.
+     * The calling thread computes one node of every level itself and waits for the others.
+     * Suitable for graphs with heavy independent branches. All inputs must be set.
+     * @param executor executor running the nodes, e.g. ThreadsPool or WorkStealingPool.
+     */
+    template <Executor TExecutor>
+    void run(TExecutor &executor);
+
+    /**
+     * @brief Sets all inputs, runs the graph and returns its outputs.
+     * @param inputs values of the inputs with indices 0, 1, ...
+     * @return result of the output if there is one output, otherwise tuple of the results of outputs.
+     */
+    template <typename ...TArgs>
+    auto evaluate(TArgs&& ...inputs);
+
+    /**
+     * @brief Returns the result of the node computed by the last run.
+     * @tparam TNode the node, it must be a part of the graph.
+     */
+    template <class TNode>
+    const std::optional<typename TNode::type>& getResult() const;
+
+private:
+    template <size_t i>
+    using NodeAt = std::tuple_element_t<i, typename StaticGraphDetail::ToTuple<TNodes>::type>;
+
+    template <size_t i>
+    void compute();
+
+    template <size_t i, class ...TDeps>
+    void computeNode(StaticGraphDetail::TypeList<TDeps...>);
+
+    template <size_t ...is>
+    static constexpr auto makeComputers(std::index_sequence<is...>);
+
+    static constexpr auto levels = []<size_t ...is>(std::index_sequence<is...>){
+        return std::array<size_t, nodesCount>{NodeAt<is>::level...};
+    }(std::make_index_sequence<nodesCount>{});
+
+    static constexpr size_t maxLevel = *std::max_element(levels.begin(), levels.end());
+
+    // ids of nodes sorted by level
+    static constexpr auto levelOrder = []{
+        std::array<size_t, nodesCount> order{};
+        for(size_t i = 0; i < nodesCount; ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [](size_t a, size_t b){
+            return levels[a] != levels[b] ? levels[a] < levels[b] : a < b;
+        });
+        return order;
+    }();
+
+    // nodes of level l take positions [levelBegin[l], levelBegin[l + 1]) in levelOrder
+    static constexpr auto levelBegin = []{
+        std::array<size_t, maxLevel + 2> begin{};
+        for(size_t level : levels)
+            ++begin[level + 1];
+        for(size_t l = 1; l < begin.size(); ++l)
+            begin[l] += begin[l - 1];
+        return begin;
+    }();
+
+    typename StaticGraphDetail::Results<TNodes>::type results;
+};
+
+
+
+template <class ...TOutputs>
+template <size_t index, typename T>
+void StaticGraph<TOutputs...>::setInput(T &&val)
+{
+    std::get<StaticGraphDetail::InputPosition<index, TNodes>::value>(results).emplace(std::forward<T>(val));
+}
+
+template <class ...TOutputs>
+void StaticGraph<TOutputs...>::run()
+{
+    [this]<size_t ...is>(std::index_sequence<is...>){
+        (compute<is>(), ...);
+    }(std::make_index_sequence<nodesCount>{});
+}
+
+template <class ...TOutputs>
+template <Executor TExecutor>
+void StaticGraph<TOutputs...>::run(TExecutor &executor)
+{
+    static constexpr auto computers = makeComputers(std::make_index_sequence<nodesCount>{});
+
+    // level 0 consists of inputs
+    for(size_t level = 1; level <= maxLevel; ++level)
+    {
+        size_t begin = levelBegin[level], end = levelBegin[level + 1];
+        std::latch done(static_cast<std::ptrdiff_t>(end - begin - 1));
+        for(size_t k = begin + 1; k < end; ++k)
+            executor.submit([this, &done, id = levelOrder[k]]{
+                (this->*computers[id])();
+                done.count_down();
+            });
+
+        (this->*computers[levelOrder[begin]])();
+        done.wait();
+    }
+}
+
+template <class ...TOutputs>
+template <typename ...TArgs>
+auto StaticGraph<TOutputs...>::evaluate(TArgs&& ...inputs)
+{
+    static_assert(sizeof...(TArgs) == inputsCount, "Values of all inputs must be passed");
+    [&]<size_t ...is>(std::index_sequence<is...>){
+        (setInput<is>(std::forward<TArgs>(inputs)), ...);
+    }(std::index_sequence_for<TArgs...>{});
+    run();
+
+    if constexpr(sizeof...(TOutputs) == 1)
+        return *getResult<TOutputs...>();
+    else
+        return std::tuple{*getResult<TOutputs>()...};
+}
+
+template <class ...TOutputs>
+template <class TNode>
+const std::optional<typename TNode::type>& StaticGraph<TOutputs...>::getResult() const
+{
+    return std::get<StaticGraphDetail::IndexOf<TNode, TNodes>::value>(results);
+}
+
+template <class ...TOutputs>
+template <size_t i>
+void StaticGraph<TOutputs...>::compute()
+{
+    if constexpr(!StaticGraphDetail::IsInput<NodeAt<i>>::value)
+        computeNode<i>(typename StaticGraphDetail::Dependencies<NodeAt<i>>::type{});
+}
+
+template <class ...TOutputs>
+template <size_t i, class ...TDeps>
+void StaticGraph<TOutputs...>::computeNode(StaticGraphDetail::TypeList<TDeps...>)
+{
+    std::get<i>(results).emplace(NodeAt<i>::compute(*std::get<StaticGraphDetail::IndexOf<TDeps, TNodes>::value>(results)...));
+}
+
+template <class ...TOutputs>
+template <size_t ...is>
+constexpr auto StaticGraph<TOutputs...>::makeComputers(std::index_sequence<is...>)
+{
+    return std::array<void (StaticGraph::*)(), nodesCount>{&StaticGraph::compute<is>...};
+}
+
+
+#endif //COMPUTATIONALGRAPH_STATICGRAPH_HPP
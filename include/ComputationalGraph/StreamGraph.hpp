@@ -0,0 +1,451 @@
+#ifndef COMPUTATIONALGRAPH_STREAMGRAPH_HPP
+#define COMPUTATIONALGRAPH_STREAMGRAPH_HPP
+
+#include <memory>
+#include <vector>
+#include <tuple>
+#include <functional>
+#include <atomic>
+#include "SPSCQueue.hpp"
+#include "EventCount.hpp"
+#include "ThreadsPool.hpp"
+#include "Executor.hpp"
+
+
+/**
+ * @brief Node of StreamGraph, processes a sequence of items instead of a single value.
+ */
+class IStreamNode
+{
+public:
+    explicit IStreamNode(size_t id_):
+        id(id_)
+    {}
+
+    virtual ~IStreamNode() = default;
+
+    IStreamNode(const IStreamNode&) = delete;
+    IStreamNode& operator=(const IStreamNode&) = delete;
+
+    size_t getId() const
+    {return id;}
+
+    /**
+     * @brief Checks whether every input queue has an item and every output queue has room for the result.
+     * May be called by any thread.
+     */
+    virtual bool canRun() const = 0;
+
+    /**
+     * @brief Takes an item from every input queue and pushes the result to every output queue.
+     * Called only if canRun() is true, never concurrently.
+     */
+    virtual void runOne() = 0;
+
+protected:
+    template <Executor TExecutor>
+    friend class StreamGraph;
+
+    size_t id;
+    std::vector<IStreamNode*> producers;
+    std::vector<IStreamNode*> consumers;
+    // the node has a job in the executor (or it is running), so at most one thread runs it
+    std::atomic<bool> scheduled{false};
+};
+
+
+/**
+ * @brief Stream node producing items of type T.
+ * Every consumer has its own bounded queue, which gets a copy of every item.
+ * @tparam T type of the items.
+ */
+template <typename T>
+class StreamOutput : public IStreamNode
+{
+public:
+    using IStreamNode::IStreamNode;
+
+    /**
+     * @brief Registers the callback which gets every item, in the order of the stream.
+     * It is called by the thread running the node, so it should be cheap.
+     * Callbacks must be registered before the first item is pushed.
+     */
+    void onOutput(std::function<void(const T&)> callback);
+
+    /**
+     * @brief Connects the queue of the consumer to the output.
+     */
+    void addOutput(SPSCQueue<T> &queue, IStreamNode &consumer);
+
+protected:
+    bool hasRoom() const;
+
+    void emit(T &&item);
+
+    std::vector<SPSCQueue<T>*> outputs;
+    std::vector<std::function<void(const T&)>> callbacks;
+};
+
+
+/**
+ * @brief Stream node applying the function to the items of its inputs.
+ * The n-th item of the node is computed from the n-th items of the inputs.
+ * @tparam TOutput type of the output items.
+ * @tparam TInputs types of the input items.
+ */
+template <typename TOutput, typename ...TInputs>
+class StreamNode : public StreamOutput<TOutput>
+{
+public:
+    using TFunction = std::function<TOutput(const TInputs&...)>;
+
+    /**
+     * @brief Creates node connected to the producers.
+     * @param id_ Node's id.
+     * @param func the function, it is called for the items one after another.
+     * @param capacity capacity of every input queue.
+     * @param nodes producers of the inputs.
+     */
+    StreamNode(size_t id_, TFunction func, size_t capacity, StreamOutput<TInputs>& ...nodes);
+
+    bool canRun() const override;
+
+    void runOne() override;
+
+protected:
+    /**
+     * @brief Creates node with empty input queues which are not connected to producers.
+     */
+    StreamNode(size_t id_, TFunction func, size_t capacity);
+
+    static_assert(sizeof...(TInputs) > 0, "StreamNode must have inputs, use StreamInput for the sources");
+
+    TFunction function;
+    std::tuple<std::unique_ptr<SPSCQueue<TInputs>>...> inputQueues;
+};
+
+
+/**
+ * @brief Stream node whose items are pushed by StreamGraph::push.
+ * Only one thread at a time may push items to the same input.
+ */
+template <typename T>
+class StreamInput : public StreamNode<T, T>
+{
+public:
+    StreamInput(size_t id_, size_t capacity);
+
+    SPSCQueue<T>& getQueue()
+    {return *std::get<0>(StreamNode<T, T>::inputQueues);}
+
+    void runOne() override;
+
+private:
+    template <Executor TExecutor>
+    friend class StreamGraph;
+
+    EventCount space;   // wakes the thread waiting in StreamGraph::push
+};
+
+
+/**
+ * @brief Graph of nodes which process streams of items. Every edge is a bounded SPSC queue,
+ * a node runs whenever every input has an item and every output has room, so different items
+ * are processed by different stages at the same time. When a consumer falls behind, its queue
+ * fills up, the producer stops and its own inputs fill up, up to StreamGraph::push which waits.
+ * Unlike ComputationalGraph nodes keep no result: every item is passed to the consumers and callbacks.
+ * @code
+ * StreamGraph graph(4);
+ * auto &input = graph.addInput<int>();
+ * auto &square = graph.addNode<long, int>([](int x){return long(x) * x;}, input);
+ * square.onOutput([](long y){std::cout << y << '\n';});
+ * for(int i = 0; i < 1000; ++i)
+ *     graph.push(input, i);
+ * graph.wait();
+ * @endcode
+ * @tparam TExecutor executor which runs the nodes, e.g. ThreadsPool or WorkStealingPool.
+ */
+template <Executor TExecutor = ThreadsPool<>>
+class StreamGraph
+{
+public:
+    /**
+     * @brief Creates StreamGraph with executor with specified count of threads.
+     * @param threadsCount count of threads.
+     * @param queueCapacity_ capacity of the queue of every edge, it bounds the items in flight.
+     */
+    explicit StreamGraph(int threadsCount, size_t queueCapacity_ = 64);
+
+    /**
+     * @brief Waits until all pushed items are processed.
+     */
+    ~StreamGraph();
+
+    /**
+     * @brief Adds input node. Nodes must not be added while items are processed.
+     * @tparam T type of the items.
+     */
+    template <typename T>
+    StreamInput<T>& addInput();
+
+    /**
+     * @brief Adds node computing func for every set of input items.
+     * @tparam TOutput type of the output items.
+     * @tparam TInputs types of the input items.
+     * @param func the function.
+     * @param nodes producers of the inputs.
+     */
+    template <typename TOutput, typename ...TInputs, class TFunction>
+    StreamNode<TOutput, TInputs...>& addNode(TFunction &&func, StreamOutput<TInputs>& ...nodes);
+
+    /**
+     * @brief Pushes the item to the input if its queue is not full.
+     * @return true if the item was pushed.
+     */
+    template <typename T, typename TT>
+    bool tryPush(StreamInput<T> &input, TT &&item);
+
+    /**
+     * @brief Pushes the item to the input, waits while its queue is full (backpressure).
+     */
+    template <typename T, typename TT>
+    void push(StreamInput<T> &input, TT &&item);
+
+    /**
+     * @brief Waits until all pushed items are processed.
+     * Items of a node whose other inputs have no matching items stay in its queues.
+     */
+    void wait();
+
+private:
+    inline void schedule(IStreamNode &node);
+    inline void runNode(IStreamNode &node);
+
+    // count of items run by a job before the node is submitted again, so nodes share the threads
+    static constexpr size_t batchSize = 32;
+
+    size_t queueCapacity;
+    std::vector<std::unique_ptr<IStreamNode>> nodes;
+
+    std::atomic<size_t> pendingCount{0};    // nodes scheduled or running
+    EventCount drained;
+
+    // the executor is destroyed before the nodes
+    TExecutor executor;
+};
+
+
+
+template<typename T>
+void StreamOutput<T>::onOutput(std::function<void(const T&)> callback)
+{
+    callbacks.push_back(std::move(callback));
+}
+
+template<typename T>
+void StreamOutput<T>::addOutput(SPSCQueue<T> &queue, IStreamNode &consumer)
+{
+    outputs.push_back(&queue);
+    consumers.push_back(&consumer);
+}
+
+template<typename T>
+bool StreamOutput<T>::hasRoom() const
+{
+    for(const auto *queue : outputs)
+        if(queue->full())
+            return false;
+    return true;
+}
+
+template<typename T>
+void StreamOutput<T>::emit(T &&item)
+{
+    for(const auto &callback : callbacks)
+        callback(item);
+    if(outputs.empty())
+        return;
+    // the node is the only producer of its queues, so the room checked by canRun is still there
+    for(size_t i = 0; i + 1 < outputs.size(); ++i)
+        outputs[i]->tryPush(item);
+    outputs.back()->tryPush(std::move(item));
+}
+
+
+template<typename TOutput, typename ...TInputs>
+StreamNode<TOutput, TInputs...>::StreamNode(size_t id_, TFunction func, size_t capacity):
+    StreamOutput<TOutput>(id_),
+    function(std::move(func)),
+    inputQueues(std::make_unique<SPSCQueue<TInputs>>(capacity)...)
+{}
+
+template<typename TOutput, typename ...TInputs>
+StreamNode<TOutput, TInputs...>::StreamNode(size_t id_, TFunction func, size_t capacity,
+                                            StreamOutput<TInputs>& ...nodes):
+    StreamNode(id_, std::move(func), capacity)
+{
+    std::apply([&](auto& ...queues){
+        (nodes.addOutput(*queues, *this), ...);
+    }, inputQueues);
+    (IStreamNode::producers.push_back(&nodes), ...);
+}
+
+template<typename TOutput, typename ...TInputs>
+bool StreamNode<TOutput, TInputs...>::canRun() const
+{
+    bool inputsReady = std::apply([](const auto& ...queues){
+        return (!queues->empty() && ...);
+    }, inputQueues);
+    return inputsReady && StreamOutput<TOutput>::hasRoom();
+}
+
+template<typename TOutput, typename ...TInputs>
+void StreamNode<TOutput, TInputs...>::runOne()
+{
+    TOutput item = std::apply([this](auto& ...queues){
+        return function(queues->front()...);
+    }, inputQueues);
+    std::apply([](auto& ...queues){
+        (queues->pop(), ...);
+    }, inputQueues);
+    StreamOutput<TOutput>::emit(std::move(item));
+}
+
+
+template<typename T>
+StreamInput<T>::StreamInput(size_t id_, size_t capacity):
+    StreamNode<T, T>(id_, [](const T &item){return item;}, capacity)
+{}
+
+
+template<typename T>
+void StreamInput<T>::runOne()
+{
+    StreamNode<T, T>::runOne();
+    space.notifyOne();
+}
+
+
+template<Executor TExecutor>
+StreamGraph<TExecutor>::StreamGraph(int threadsCount, size_t queueCapacity_):
+    queueCapacity(queueCapacity_),
+    executor(threadsCount)
+{}
+
+template<Executor TExecutor>
+StreamGraph<TExecutor>::~StreamGraph()
+{
+    wait();
+}
+
+template<Executor TExecutor>
+template<typename T>
+StreamInput<T>& StreamGraph<TExecutor>::addInput()
+{
+    auto node = std::make_unique<StreamInput<T>>(nodes.size(), queueCapacity);
+    auto &ref = *node;
+    nodes.push_back(std::move(node));
+    return ref;
+}
+
+template<Executor TExecutor>
+template<typename TOutput, typename ...TInputs, class TFunction>
+StreamNode<TOutput, TInputs...>& StreamGraph<TExecutor>::addNode(TFunction &&func, StreamOutput<TInputs>& ...producers)
+{
+    auto node = std::make_unique<StreamNode<TOutput, TInputs...>>(nodes.size(), std::forward<TFunction>(func),
+                                                                   queueCapacity, producers...);
+    auto &ref = *node;
+    nodes.push_back(std::move(node));
+    return ref;
+}
+
+template<Executor TExecutor>
+template<typename T, typename TT>
+bool StreamGraph<TExecutor>::tryPush(StreamInput<T> &input, TT &&item)
+{
+    if(!input.getQueue().tryPush(std::forward<TT>(item)))
+        return false;
+    schedule(input);
+    return true;
+}
+
+template<Executor TExecutor>
+template<typename T, typename TT>
+void StreamGraph<TExecutor>::push(StreamInput<T> &input, TT &&item)
+{
+    // tryPush leaves the item untouched if the queue is full
+    while(!tryPush(input, std::forward<TT>(item)))
+    {
+        uint32_t key = input.space.prepareWait();
+        if(!input.getQueue().full())
+        {
+            input.space.cancelWait();
+            continue;
+        }
+        input.space.wait(key);
+    }
+}
+
+template<Executor TExecutor>
+void StreamGraph<TExecutor>::wait()
+{
+    while(true)
+    {
+        uint32_t key = drained.prepareWait();
+        if(pendingCount.load(std::memory_order_seq_cst) == 0)
+        {
+            drained.cancelWait();
+            return;
+        }
+        drained.wait(key);
+    }
+}
+
+template<Executor TExecutor>
+void StreamGraph<TExecutor>::schedule(IStreamNode &node)
+{
+    // pairs with the fence of runNode: either the node sees the pushed item or we see it is not scheduled
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(node.scheduled.load(std::memory_order_seq_cst) || !node.canRun()
+        || node.scheduled.exchange(true, std::memory_order_acq_rel))
+        return;
+    pendingCount.fetch_add(1, std::memory_order_relaxed);
+    executor.submit([this, &node]{runNode(node);});
+}
+
+template<Executor TExecutor>
+void StreamGraph<TExecutor>::runNode(IStreamNode &node)
+{
+    size_t count = 0;
+    while(count < batchSize && node.canRun())
+    {
+        node.runOne();
+        ++count;
+        // consumers got an item, producers got room
+        for(auto *consumer : node.consumers)
+            schedule(*consumer);
+        for(auto *producer : node.producers)
+            schedule(*producer);
+    }
+
+    if(count == batchSize)
+    {
+        // the node stays scheduled and lets other nodes run
+        executor.submit([this, &node]{runNode(node);});
+        return;
+    }
+
+    node.scheduled.store(false, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(node.canRun() && !node.scheduled.exchange(true, std::memory_order_acq_rel))
+    {
+        executor.submit([this, &node]{runNode(node);});
+        return;
+    }
+
+    if(pendingCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        drained.notifyAll();
+}
+
+
+#endif //COMPUTATIONALGRAPH_STREAMGRAPH_HPP
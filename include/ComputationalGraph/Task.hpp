@@ -0,0 +1,238 @@
+#ifndef COMPUTATIONALGRAPH_TASK_HPP
+#define COMPUTATIONALGRAPH_TASK_HPP
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <functional>
+
+
+template <typename T>
+class Task;
+
+namespace TaskDetail
+{
+    template <typename T>
+    struct PromiseResult
+    {
+        std::optional<T> value;
+
+        template <typename TT>
+        void return_value(TT &&val)
+        {value.emplace(std::forward<TT>(val));}
+
+        T take()
+        {return std::move(*value);}
+    };
+
+    template <>
+    struct PromiseResult<void>
+    {
+        void return_void()
+        {}
+
+        void take()
+        {}
+    };
+}
+
+
+/**
+ * @brief Lazy coroutine computing value of type T, e.g. the result of AsyncNode.
+ * The coroutine starts when it is awaited by another Task or started by Task::start,
+ * after it suspends (e.g. on awaitCallback) the thread which started it is free.
+ * When it completes, the awaiting Task is resumed by the same thread without recursion.
+ * @code
+ * Task<Blob> fetch(const Key &key)
+ * {
+ *     Blob blob = co_await awaitCallback<Blob>([&](auto resume){client.get(key, std::move(resume));});
+ *     co_return blob;
+ * }
+ * @endcode
+ * @tparam T type of the value, may be void.
+ */
+template <typename T>
+class Task
+{
+public:
+    struct promise_type : TaskDetail::PromiseResult<T>
+    {
+        std::coroutine_handle<> continuation;
+        std::function<void()> onComplete;
+        std::exception_ptr exception;
+
+        Task get_return_object()
+        {return Task(std::coroutine_handle<promise_type>::from_promise(*this));}
+
+        std::suspend_always initial_suspend() noexcept
+        {return {};}
+
+        auto final_suspend() noexcept
+        {
+            struct FinalAwaiter
+            {
+                bool await_ready() noexcept
+                {return false;}
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+                {
+                    auto &promise = handle.promise();
+                    if(promise.continuation)
+                        return promise.continuation;
+                    // the callback may let another thread destroy the frame, so it is moved out of it,
+                    // the value is kept in the frame until then
+                    if(promise.onComplete)
+                    {
+                        std::function<void()> onComplete = std::move(promise.onComplete);
+                        onComplete();
+                    }
+                    return std::noop_coroutine();
+                }
+
+                void await_resume() noexcept
+                {}
+            };
+            return FinalAwaiter{};
+        }
+
+        void unhandled_exception()
+        {exception = std::current_exception();}
+    };
+
+    Task() = default;
+
+    Task(Task &&task) noexcept:
+        handle(std::exchange(task.handle, nullptr))
+    {}
+
+    Task& operator=(Task &&task) noexcept
+    {
+        if(this != &task)
+        {
+            if(handle)
+                handle.destroy();
+            handle = std::exchange(task.handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if(handle)
+            handle.destroy();
+    }
+
+    /**
+     * @brief Starts the coroutine which is not awaited by another Task.
+     * @param onComplete called by the thread which completes the coroutine (possibly this one, before start returns).
+     */
+    void start(std::function<void()> onComplete);
+
+    bool isDone() const
+    {return handle && handle.done();}
+
+    /**
+     * @brief Returns the value of the completed coroutine.
+     * @throws the exception thrown by the coroutine.
+     */
+    T takeResult();
+
+    bool await_ready() const noexcept
+    {return false;}
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume()
+    {return takeResult();}
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle_):
+        handle(handle_)
+    {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+
+/**
+ * @brief Awaitable which starts the operation reporting its completion by a callback,
+ * e.g. the completion handler of an event loop (epoll, io_uring) or of an asynchronous client.
+ * The coroutine is resumed by the thread which calls the callback.
+ * @tparam T type of the value passed to the callback, may be void.
+ * @tparam TStart type of the function which starts the operation: start(resume),
+ * where resume(value) (resume() for void) must be called exactly once.
+ */
+template <typename T, typename TStart>
+class CallbackAwaitable
+{
+public:
+    explicit CallbackAwaitable(TStart start_):
+        start(std::move(start_))
+    {}
+
+    bool await_ready() const noexcept
+    {return false;}
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        // the coroutine may be resumed (and this awaitable destroyed) before start returns
+        if constexpr(std::is_void_v<T>)
+            start([handle]{handle.resume();});
+        else
+            start([this, handle](T val){
+                value.emplace(std::move(val));
+                handle.resume();
+            });
+    }
+
+    T await_resume()
+    {
+        if constexpr(!std::is_void_v<T>)
+            return std::move(*value);
+    }
+
+private:
+    struct Empty
+    {};
+
+    TStart start;
+    [[no_unique_address]] std::conditional_t<std::is_void_v<T>, Empty, std::optional<T>> value;
+};
+
+/**
+ * @brief Creates CallbackAwaitable.
+ * @code
+ * int bytes = co_await awaitCallback<int>([&](auto resume){socket.asyncRead(buffer, std::move(resume));});
+ * @endcode
+ */
+template <typename T, typename TStart>
+CallbackAwaitable<T, TStart> awaitCallback(TStart start)
+{
+    return CallbackAwaitable<T, TStart>(std::move(start));
+}
+
+
+
+template<typename T>
+void Task<T>::start(std::function<void()> onComplete)
+{
+    handle.promise().onComplete = std::move(onComplete);
+    handle.resume();
+}
+
+template<typename T>
+T Task<T>::takeResult()
+{
+    auto &promise = handle.promise();
+    if(promise.exception)
+        std::rethrow_exception(promise.exception);
+    return promise.take();
+}
+
+
+#endif //COMPUTATIONALGRAPH_TASK_HPP
@@ -2,10 +2,24 @@
 #define COMPUTATIONALGRAPH_CPP_THREADSPOOL_H
 
 #include <functional>
-#include <ComputationalGraph/DelayQueue.hpp>
+#include <thread>
+#include <deque>
+#include <condition_variable>
+#include <ComputationalGraph/MPMCQueue.hpp>
+#include <ComputationalGraph/TimerWheel.hpp>
+#include <ComputationalGraph/EventCount.hpp>
+#include <ComputationalGraph/Profiler.hpp>
+#include <ComputationalGraph/Topology.hpp>
 
 
-template <typename D = std::chrono::system_clock::duration>
+/**
+ * @brief Pool of threads which run immediate, delayed and repeatable jobs.
+ * Immediate jobs go through the lock free FIFO, only delayed jobs pay for the timer wheel.
+ * Delays are measured with std::chrono::steady_clock.
+ * Idle workers spin for a while and then sleep until a job is submitted,
+ * a separate timer thread sleeps until the earliest delayed job is due.
+ */
+template <typename D = std::chrono::steady_clock::duration>
 class ThreadsPool
 {
 public:
@@ -15,7 +29,20 @@ public:
         Periodic, Interval
     };
 
-    explicit ThreadsPool(int threadsCount);
+    /**
+     * @brief Creates pool and starts its threads.
+     * @param threadsCount count of workers.
+     * @param spinCount_ how many times an idle worker polls the queue before sleeping.
+     * Larger values cut the wake up latency at the cost of CPU time.
+     */
+    explicit ThreadsPool(int threadsCount, size_t spinCount_ = 256);
+
+    /**
+     * @brief Creates pool with workers pinned to the CPUs, see CpuTopology::placeWorker.
+     * The queue is shared, so the jobs are not placed on the domains (WorkStealingPool::submitTo does it).
+     */
+    ThreadsPool(int threadsCount, ThreadPinning pinning_, const CpuTopology &topology_ = CpuTopology::detect(),
+                size_t spinCount_ = 256);
     ~ThreadsPool();
 
     template <class JT>
@@ -24,80 +51,299 @@ public:
     template <class JT>
     void submitDelayed(JT &&job, D delay);
 
-    void submitRepeatable(JobType job, D repeatTime, RepeatableStrategy repeatableStrategy, bool delayed);
+    /**
+     * @brief Submits job which is run after the delay unless the handle is cancelled before.
+     */
+    template <class JT>
+    void submitDelayed(JT &&job, D delay, const TimerHandle &handle);
+
+    /**
+     * @brief Submits job which is run repeatedly until the returned handle is cancelled.
+     * @param job the job.
+     * @param repeatTime period of repeating.
+     * @param repeatableStrategy Periodic measures the period from the start of the job, Interval from its end.
+     * @param delayed if false, the first run is done immediately in the calling thread.
+     * @return handle which stops repeating.
+     */
+    TimerHandle submitRepeatable(JobType job, D repeatTime, RepeatableStrategy repeatableStrategy, bool delayed);
 
     template<class JT>
-    void submitPeriodic(JT &&job, D repeatTime, bool delayed)
-    { submitRepeatable(std::forward<JT>(job), repeatTime, Periodic, delayed); }
+    TimerHandle submitPeriodic(JT &&job, D repeatTime, bool delayed)
+    { return submitRepeatable(std::forward<JT>(job), repeatTime, Periodic, delayed); }
 
     template<class JT>
-    void submitInterval(JT &&job, D repeatTime, bool delayed)
-    { submitRepeatable(std::forward<JT>(job), repeatTime, Interval, delayed); }
+    TimerHandle submitInterval(JT &&job, D repeatTime, bool delayed)
+    { return submitRepeatable(std::forward<JT>(job), repeatTime, Interval, delayed); }
 
     size_t size() const
-    {return jobsQueue.size();}
+    {return immediateJobs.size() + overflowCount + timers.size();}
+
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    /**
+     * @brief Returns counters of every worker, available if COMPUTATIONALGRAPH_PROFILING is defined.
+     */
+    std::vector<WorkerStats> getWorkerStats() const;
+#endif
 
 private:
-    void threadFunction();
+    struct RepeatableJob
+    {
+        JobType job;
+        D repeatTime;
+        RepeatableStrategy strategy;
+        TimerHandle handle;
+    };
+
+    void threadFunction(size_t index);
+    void timerFunction();
+    void runRepeatable(const std::shared_ptr<RepeatableJob> &repeatable, bool runNow);
+
+    template <class JT>
+    void addTimer(JT &&job, D delay, const TimerHandle *handle);
+
+    template <class JT>
+    void pushImmediate(JT &&job);
+    std::optional<JobType> popImmediate();
+
+    MPMCQueue<JobType> immediateJobs;
+    // takes the jobs when immediateJobs is full
+    std::deque<JobType> overflowJobs;
+    std::atomic<size_t> overflowCount;
+    std::mutex overflowMutex;
+
+    TimerWheel<JobType> timers;
+    std::atomic<typename TimerWheel<JobType>::TimePoint> timerWakeUp;
+    std::mutex timerMutex;
+    std::condition_variable timerCondition;
+
+    size_t spinCount;
+    ThreadPinning pinning = ThreadPinning::None;
+    CpuTopology topology;
+    EventCount idleWorkers;
+
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    std::unique_ptr<WorkerCounters[]> workerCounters;
+    size_t workersCount;
+#endif
 
-    DelayQueue<JobType> jobsQueue;
-    std::vector<std::thread> threads;
     std::atomic<bool> running;
+    std::vector<std::thread> threads;
+    std::thread timerThread;
 };
 
 
 template<typename D>
-ThreadsPool<D>::ThreadsPool(int threadsCount):
+ThreadsPool<D>::ThreadsPool(int threadsCount, size_t spinCount_):
+    overflowCount(0),
+    timerWakeUp(TimerWheel<JobType>::TimePoint::max()),
+    spinCount(spinCount_),
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    workerCounters(new WorkerCounters[threadsCount]),
+    workersCount(threadsCount),
+#endif
+    running(true)
+{
+    for(int i = 0; i < threadsCount; ++i)
+        threads.emplace_back(&ThreadsPool::threadFunction, this, i);
+    timerThread = std::thread(&ThreadsPool::timerFunction, this);
+}
+
+template<typename D>
+ThreadsPool<D>::ThreadsPool(int threadsCount, ThreadPinning pinning_, const CpuTopology &topology_, size_t spinCount_):
+    overflowCount(0),
+    timerWakeUp(TimerWheel<JobType>::TimePoint::max()),
+    spinCount(spinCount_),
+    pinning(pinning_),
+    topology(topology_),
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    workerCounters(new WorkerCounters[threadsCount]),
+    workersCount(threadsCount),
+#endif
     running(true)
 {
     for(int i = 0; i < threadsCount; ++i)
-        threads.emplace_back(&ThreadsPool::threadFunction, this);
+        threads.emplace_back(&ThreadsPool::threadFunction, this, i);
+    timerThread = std::thread(&ThreadsPool::timerFunction, this);
+}
+
+template <typename D>
+template <class JT>
+void ThreadsPool<D>::pushImmediate(JT &&job)
+{
+    if(!immediateJobs.tryPush(std::forward<JT>(job)))
+    {
+        std::lock_guard lock(overflowMutex);
+        overflowJobs.emplace_back(std::forward<JT>(job));
+        ++overflowCount;
+    }
+
+    idleWorkers.notifyOne();
+}
+
+template <typename D>
+std::optional<typename ThreadsPool<D>::JobType> ThreadsPool<D>::popImmediate()
+{
+    if(auto job = immediateJobs.pop())
+        return job;
+
+    if(overflowCount > 0)
+    {
+        std::lock_guard lock(overflowMutex);
+        if(!overflowJobs.empty())
+        {
+            JobType job = std::move(overflowJobs.front());
+            overflowJobs.pop_front();
+            --overflowCount;
+            return job;
+        }
+    }
+    return {};
 }
 
 template <typename D>
 template <class JT>
 void ThreadsPool<D>::submit(JT &&job)
 {
-    jobsQueue.push(std::forward<JT>(job), D(0));
+    pushImmediate(std::forward<JT>(job));
+}
+
+template <typename D>
+template <class JT>
+void ThreadsPool<D>::addTimer(JT &&job, D delay, const TimerHandle *handle)
+{
+    auto deadline = timers.add(JobType(std::forward<JT>(job)), std::chrono::duration_cast<typename TimerWheel<JobType>::Duration>(delay), handle);
+
+    // the timer thread sleeps until a later time, so it must be woken up
+    if(deadline < timerWakeUp.load())
+    {
+        std::lock_guard lock(timerMutex);
+        timerCondition.notify_one();
+    }
 }
 
 template <typename D>
 template <class JT>
 void ThreadsPool<D>::submitDelayed(JT &&job, D delay)
 {
-    jobsQueue.push(std::forward<JT>(job), delay);
+    addTimer(std::forward<JT>(job), delay, nullptr);
+}
+
+template <typename D>
+template <class JT>
+void ThreadsPool<D>::submitDelayed(JT &&job, D delay, const TimerHandle &handle)
+{
+    addTimer(std::forward<JT>(job), delay, &handle);
+}
+
+template <typename D>
+TimerHandle ThreadsPool<D>::submitRepeatable(JobType job, D repeatTime, RepeatableStrategy repeatableStrategy, bool delayed)
+{
+    auto repeatable = std::make_shared<RepeatableJob>(RepeatableJob{std::move(job), repeatTime, repeatableStrategy, {}});
+    runRepeatable(repeatable, !delayed);
+    return repeatable->handle;
 }
 
 template <typename D>
-void ThreadsPool<D>::submitRepeatable(JobType job, D repeatTime, RepeatableStrategy repeatableStrategy, bool delayed)
+void ThreadsPool<D>::runRepeatable(const std::shared_ptr<RepeatableJob> &repeatable, bool runNow)
 {
-    // TODO: perfect lambda capture
-    auto repeatableJob = [this, job, repeatTime, repeatableStrategy]{
-        submitRepeatable(job, repeatTime, repeatableStrategy, false);
+    auto next = [this, repeatable]{
+        runRepeatable(repeatable, true);
     };
 
-    if(repeatableStrategy == Periodic)
+    if(repeatable->handle.isCancelled())
+        return;
+
+    if(repeatable->strategy == Periodic)
     {
-        submitDelayed(repeatableJob, repeatTime);
-        if(!delayed)
-            job();
+        submitDelayed(next, repeatable->repeatTime, repeatable->handle);
+        if(runNow)
+            repeatable->job();
     }
-    else if(repeatableStrategy == Interval)
+    else if(repeatable->strategy == Interval)
     {
-        if(!delayed)
-            job();
-        submitDelayed(repeatableJob, repeatTime);
+        if(runNow)
+            repeatable->job();
+        submitDelayed(next, repeatable->repeatTime, repeatable->handle);
     }
 }
 
 template<typename D>
-void ThreadsPool<D>::threadFunction()
+void ThreadsPool<D>::threadFunction(size_t index)
 {
+    if(pinning != ThreadPinning::None)
+        pinWorker(topology, index, pinning);
+    bool wokenUp = false;
     while(running)
     {
-        auto job = jobsQueue.popWait(std::chrono::milliseconds(1));
-        if(job)
+        if(auto job = popImmediate())
+        {
+            // wake ups are not repeated while this worker was waking up, so it passes the rest further
+            if(wokenUp && (!immediateJobs.empty() || overflowCount > 0))
+                idleWorkers.notifyOne();
+            wokenUp = false;
+#ifdef COMPUTATIONALGRAPH_PROFILING
+            workerCounters[index].count(workerCounters[index].jobsCount);
+#endif
             job.value()();
+            continue;
+        }
+
+        bool found = false;
+        for(size_t i = 0; i < spinCount && !found; ++i)
+        {
+            cpuRelax();
+            found = !immediateJobs.empty() || overflowCount > 0;
+        }
+        if(found)
+            continue;
+
+        uint32_t key = idleWorkers.prepareWait();
+        if(!running || !immediateJobs.empty() || overflowCount > 0)
+            idleWorkers.cancelWait();
+        else
+        {
+#ifdef COMPUTATIONALGRAPH_PROFILING
+            workerCounters[index].count(workerCounters[index].idleCount);
+#endif
+            idleWorkers.wait(key);
+            wokenUp = true;
+        }
+    }
+}
+
+#ifdef COMPUTATIONALGRAPH_PROFILING
+template<typename D>
+std::vector<WorkerStats> ThreadsPool<D>::getWorkerStats() const
+{
+    std::vector<WorkerStats> stats;
+    for(size_t i = 0; i < workersCount; ++i)
+        stats.push_back(workerCounters[i].load());
+    return stats;
+}
+#endif
+
+template<typename D>
+void ThreadsPool<D>::timerFunction()
+{
+    std::vector<JobType> expired;
+    std::unique_lock lock(timerMutex);
+    while(running)
+    {
+        // timers added during the scan see the maximal wake up time and notify this thread
+        timerWakeUp = TimerWheel<JobType>::TimePoint::max();
+        auto deadline = timers.nextDeadline();
+        timerWakeUp = deadline;
+        if(deadline == TimerWheel<JobType>::TimePoint::max())
+            timerCondition.wait(lock);
+        else
+            timerCondition.wait_until(lock, deadline);
+
+        lock.unlock();
+        timers.advance(std::chrono::steady_clock::now(), expired);
+        for(auto &job : expired)
+            pushImmediate(std::move(job));
+        expired.clear();
+        lock.lock();
     }
 }
 
@@ -105,8 +351,14 @@ template<typename D>
 ThreadsPool<D>::~ThreadsPool()
 {
     running = false;
+    idleWorkers.notifyAll();
+    {
+        std::lock_guard lock(timerMutex);
+        timerCondition.notify_one();
+    }
     for(auto &t : threads)
         t.join();
+    timerThread.join();
 }
 
 
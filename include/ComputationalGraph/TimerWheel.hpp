@@ -0,0 +1,208 @@
+#ifndef COMPUTATIONALGRAPH_TIMERWHEEL_HPP
+#define COMPUTATIONALGRAPH_TIMERWHEEL_HPP
+
+#include <chrono>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+
+/**
+ * @brief Handle which cancels a timer (or a chain of timers of a repeatable job).
+ * Cancellation is lazy: the entry stays in the wheel and is dropped when its slot is reached.
+ */
+class TimerHandle
+{
+public:
+    TimerHandle():
+        cancelled(std::make_shared<std::atomic<bool>>(false))
+    {}
+
+    void cancel()
+    {*cancelled = true;}
+
+    bool isCancelled() const
+    {return *cancelled;}
+
+private:
+    template <typename T, typename TClock>
+    friend class TimerWheel;
+
+    std::shared_ptr<std::atomic<bool>> cancelled;
+};
+
+
+/**
+ * @brief Hashed timer wheel (Varghese, Lauck). Insert and cancel are O(1),
+ * advancing costs O(1) per passed tick plus the count of entries in the visited slots.
+ * Ticks only bucket the entries: every entry keeps its exact deadline, it expires once the time passed
+ * to advance reaches it, and nextDeadline returns it, so the waiting thread is not late by a tick.
+ * @tparam T type of the stored value (e.g. job).
+ * @tparam TClock monotonic clock.
+ */
+template <typename T, typename TClock = std::chrono::steady_clock>
+class TimerWheel
+{
+public:
+    using Duration = typename TClock::duration;
+    using TimePoint = typename TClock::time_point;
+
+    /**
+     * @brief Creates empty wheel.
+     * @param tick_ width of a slot, it affects only the cost of scans, not the accuracy.
+     * @param slotsCount count of slots, rounded up to the power of two.
+     */
+    explicit TimerWheel(Duration tick_ = std::chrono::milliseconds(1), size_t slotsCount = 512);
+
+    /**
+     * @brief Adds value which expires after the delay.
+     * @param val the value.
+     * @param delay the delay.
+     * @param handle optional handle which cancels the entry.
+     * @return time when the entry expires.
+     */
+    template <typename TT>
+    TimePoint add(TT &&val, Duration delay, const TimerHandle *handle = nullptr);
+
+    /**
+     * @brief Moves all values which are expired at the time `now` to `expired`.
+     * @return count of expired values.
+     */
+    size_t advance(TimePoint now, std::vector<T> &expired);
+
+    /**
+     * @brief Returns the time when the earliest entry expires, or TimePoint::max() if there are no entries.
+     * Costs O(count of slots) in the worst case.
+     */
+    TimePoint nextDeadline();
+
+    Duration getTick() const
+    {return tick;}
+
+    size_t size() const
+    {return count;}
+    bool empty() const
+    {return size() == 0;}
+
+private:
+    struct Entry
+    {
+        T value;
+        uint64_t deadlineTick;
+        TimePoint deadline;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+    };
+
+    uint64_t toTick(TimePoint time) const
+    {return static_cast<uint64_t>((time - startTime) / tick);}
+
+    Duration tick;
+    TimePoint startTime;
+    size_t mask;
+    std::vector<std::vector<Entry>> slots;
+
+    // the first tick which is not processed completely yet
+    std::atomic<uint64_t> nextTick;
+    std::atomic<size_t> count;
+    std::mutex wheelMutex;
+};
+
+
+template<typename T, typename TClock>
+TimerWheel<T, TClock>::TimerWheel(Duration tick_, size_t slotsCount):
+    tick(tick_),
+    startTime(TClock::now()),
+    nextTick(0),
+    count(0)
+{
+    size_t powerOfTwo = 1;
+    while(powerOfTwo < slotsCount)
+        powerOfTwo <<= 1;
+    mask = powerOfTwo - 1;
+    slots.resize(powerOfTwo);
+}
+
+template<typename T, typename TClock>
+template<typename TT>
+typename TimerWheel<T, TClock>::TimePoint TimerWheel<T, TClock>::add(TT &&val, Duration delay, const TimerHandle *handle)
+{
+    TimePoint deadline = TClock::now() + std::max(delay, Duration::zero());
+    std::lock_guard lock(wheelMutex);
+    // an entry due in a processed tick is placed into the current one, it expires on the next advance
+    uint64_t deadlineTick = std::max(toTick(deadline), nextTick.load(std::memory_order_relaxed));
+    slots[deadlineTick & mask].push_back(Entry{std::forward<TT>(val), deadlineTick, deadline,
+                                               handle ? handle->cancelled : nullptr});
+    ++count;
+    return deadline;
+}
+
+template<typename T, typename TClock>
+typename TimerWheel<T, TClock>::TimePoint TimerWheel<T, TClock>::nextDeadline()
+{
+    std::lock_guard lock(wheelMutex);
+    if(count == 0)
+        return TimePoint::max();
+
+    // entries of a tick are due before the entries of the later ticks,
+    // so the earliest one is in the first slot holding entries of the current round
+    uint64_t first = nextTick.load(std::memory_order_relaxed);
+    for(uint64_t t = first; t <= first + mask; ++t)
+    {
+        TimePoint deadline = TimePoint::max();
+        for(const auto &entry : slots[t & mask])
+            if(entry.deadlineTick <= t)
+                deadline = std::min(deadline, entry.deadline);
+        if(deadline != TimePoint::max())
+            return deadline;
+    }
+
+    TimePoint deadline = TimePoint::max();
+    for(const auto &slot : slots)
+        for(const auto &entry : slot)
+            deadline = std::min(deadline, entry.deadline);
+    return deadline;
+}
+
+template<typename T, typename TClock>
+size_t TimerWheel<T, TClock>::advance(TimePoint now, std::vector<T> &expired)
+{
+    if(empty() || now < startTime)
+        return 0;
+
+    std::lock_guard lock(wheelMutex);
+    uint64_t first = nextTick.load(std::memory_order_relaxed);
+    uint64_t last = toTick(now);
+    if(last < first)
+        return 0;
+
+    // every slot is visited at most once, however long the wheel was not advanced
+    uint64_t end = std::min(last, first + mask);
+    size_t expiredCount = 0;
+    for(uint64_t t = first; t <= end; ++t)
+    {
+        auto &slot = slots[t & mask];
+        for(size_t i = 0; i < slot.size();)
+        {
+            if(slot[i].deadline <= now)
+            {
+                if(!slot[i].cancelled || !*slot[i].cancelled)
+                {
+                    expired.push_back(std::move(slot[i].value));
+                    ++expiredCount;
+                }
+                std::swap(slot[i], slot.back());
+                slot.pop_back();
+                --count;
+            }
+            else
+                ++i;
+        }
+    }
+    // entries of the last tick which are due later than now are left in it
+    nextTick.store(last, std::memory_order_relaxed);
+    return expiredCount;
+}
+
+
+#endif //COMPUTATIONALGRAPH_TIMERWHEEL_HPP
@@ -0,0 +1,189 @@
+#ifndef COMPUTATIONALGRAPH_TOPOLOGY_HPP
+#define COMPUTATIONALGRAPH_TOPOLOGY_HPP
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <span>
+#include <limits>
+#include <thread>
+#include <algorithm>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+/**
+ * @brief How the workers of a pool are pinned to the CPUs.
+ */
+enum class ThreadPinning
+{
+    None,   // the scheduler of the OS places the workers
+    Core,   // every worker is pinned to one CPU, workers fill the domains one after another
+    Domain  // every worker is pinned to all CPUs of its NUMA domain
+};
+
+
+/**
+ * @brief CPUs of every NUMA domain available to the process.
+ * With pinned workers the memory allocated by a node (e.g. its result) is placed on the domain
+ * of the worker which runs it by the first touch policy of the OS, so consumers on the same domain read local memory.
+ */
+struct CpuTopology
+{
+    static constexpr size_t anyDomain = std::numeric_limits<size_t>::max();
+
+    std::vector<std::vector<int>> domains;
+
+    /**
+     * @brief Reads the topology from /sys/devices/system/node on Linux, CPUs which are not in the affinity
+     * mask of the process are skipped. Otherwise (or if it is not available) all CPUs are one domain.
+     */
+    static CpuTopology detect();
+
+    /**
+     * @brief Parses the list of CPUs in the format of sysfs, e.g. "0-3,8,10-11".
+     */
+    static std::vector<int> parseCpuList(const std::string &list);
+
+    size_t domainsCount() const
+    {return domains.size();}
+
+    /**
+     * @brief Returns the CPU and the domain of the worker: workers take the CPUs of the first domain,
+     * then of the second one and so on, and start again if there are more workers than CPUs.
+     * @param worker index of the worker.
+     * @return CPU and domain index.
+     */
+    std::pair<int, size_t> placeWorker(size_t worker) const;
+};
+
+
+/**
+ * @brief Pins the calling thread to the CPUs.
+ * @return true on success, false if it is not supported.
+ */
+inline bool pinCurrentThread(std::span<const int> cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int cpu : cpus)
+        CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+/**
+ * @brief Places the worker of the pool on the topology and pins the calling thread as requested.
+ * @return the domain of the worker.
+ */
+inline size_t pinWorker(const CpuTopology &topology, size_t worker, ThreadPinning pinning)
+{
+    auto [cpu, domain] = topology.placeWorker(worker);
+    if(pinning == ThreadPinning::Core)
+        pinCurrentThread(std::span<const int>(&cpu, 1));
+    else if(pinning == ThreadPinning::Domain)
+        pinCurrentThread(topology.domains[domain]);
+    return domain;
+}
+
+
+
+inline std::vector<int> CpuTopology::parseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+    size_t position = 0;
+    while(position < list.size())
+    {
+        size_t end = list.find(',', position);
+        if(end == std::string::npos)
+            end = list.size();
+        std::string range = list.substr(position, end - position);
+        position = end + 1;
+
+        size_t dash = range.find('-');
+        try
+        {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for(int cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+        catch(const std::exception&)
+        {
+            // trailing new line or garbage
+        }
+    }
+    return cpus;
+}
+
+inline CpuTopology CpuTopology::detect()
+{
+    std::vector<int> allowed;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(0, sizeof(set), &set) == 0)
+        for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if(CPU_ISSET(cpu, &set))
+                allowed.push_back(cpu);
+#endif
+    if(allowed.empty())
+        for(int cpu = 0; cpu < static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); ++cpu)
+            allowed.push_back(cpu);
+
+    CpuTopology topology;
+#ifdef __linux__
+    std::vector<std::pair<int, std::string>> nodes;
+    std::error_code error;
+    for(const auto &entry : std::filesystem::directory_iterator("/sys/devices/system/node", error))
+    {
+        std::string name = entry.path().filename().string();
+        if(name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+           std::all_of(name.begin() + 4, name.end(), [](char c){return c >= '0' && c <= '9';}))
+            nodes.emplace_back(std::stoi(name.substr(4)), entry.path().string() + "/cpulist");
+    }
+    std::sort(nodes.begin(), nodes.end());
+
+    for(const auto &[node, path] : nodes)
+    {
+        std::ifstream file(path);
+        std::string list;
+        if(!std::getline(file, list))
+            continue;
+        std::vector<int> cpus;
+        for(int cpu : parseCpuList(list))
+            if(std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+                cpus.push_back(cpu);
+        if(!cpus.empty())
+            topology.domains.push_back(std::move(cpus));
+    }
+#endif
+    if(topology.domains.empty())
+        topology.domains.push_back(std::move(allowed));
+    return topology;
+}
+
+inline std::pair<int, size_t> CpuTopology::placeWorker(size_t worker) const
+{
+    size_t cpusCount = 0;
+    for(const auto &cpus : domains)
+        cpusCount += cpus.size();
+    worker %= cpusCount;
+    for(size_t domain = 0; domain < domains.size(); ++domain)
+    {
+        if(worker < domains[domain].size())
+            return {domains[domain][worker], domain};
+        worker -= domains[domain].size();
+    }
+    return {domains[0][0], 0};
+}
+
+
+#endif //COMPUTATIONALGRAPH_TOPOLOGY_HPP
@@ -0,0 +1,448 @@
+#ifndef COMPUTATIONALGRAPH_TRANSPORT_HPP
+#define COMPUTATIONALGRAPH_TRANSPORT_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+/**
+ * @brief Delivers frames (messages of bytes) between the hosts running parts of one graph, see DistributedGraph.
+ * Frames from one host to another are delivered in order. Frames received before the receiver is set
+ * are kept and delivered by setReceiver.
+ */
+class ITransport
+{
+public:
+    /**
+     * @brief Called with the host which sent the frame and the frame, by a thread of the transport.
+     */
+    using TReceiver = std::function<void(size_t host, std::vector<std::byte> frame)>;
+
+    virtual ~ITransport() = default;
+
+    /**
+     * @brief Returns the index of this host.
+     */
+    virtual size_t getRank() const = 0;
+
+    virtual size_t getHostsCount() const = 0;
+
+    /**
+     * @brief Sends the frame to the host, it may return before the frame is delivered.
+     */
+    virtual void send(size_t host, std::vector<std::byte> frame) = 0;
+
+    void setReceiver(TReceiver receiver_);
+
+protected:
+    /**
+     * @brief Passes the frame to the receiver, called by the implementations.
+     */
+    void deliver(size_t host, std::vector<std::byte> frame);
+
+private:
+    TReceiver receiver;
+    std::vector<std::pair<size_t, std::vector<std::byte>>> earlyFrames;
+    std::mutex receiverMutex;
+};
+
+
+/**
+ * @brief Hosts in one process, e.g. to test distributed graphs. Every host has a thread which delivers its frames.
+ */
+class LoopbackNetwork
+{
+public:
+    explicit LoopbackNetwork(size_t hostsCount);
+    ~LoopbackNetwork();
+
+    ITransport& getTransport(size_t rank)
+    {return *transports[rank];}
+
+private:
+    class LoopbackTransport : public ITransport
+    {
+    public:
+        LoopbackTransport(LoopbackNetwork &network_, size_t rank_);
+        ~LoopbackTransport() override;
+
+        size_t getRank() const override
+        {return rank;}
+
+        size_t getHostsCount() const override
+        {return network.transports.size();}
+
+        void send(size_t host, std::vector<std::byte> frame) override;
+
+    private:
+        friend class LoopbackNetwork;
+
+        void push(size_t from, std::vector<std::byte> frame);
+        void deliveryFunction();
+
+        LoopbackNetwork &network;
+        size_t rank;
+        std::deque<std::pair<size_t, std::vector<std::byte>>> frames;
+        std::mutex framesMutex;
+        std::condition_variable framesCondition;
+        bool running = true;
+        std::thread deliveryThread;
+    };
+
+    std::vector<std::unique_ptr<LoopbackTransport>> transports;
+};
+
+
+/**
+ * @brief Address of a host in TcpTransport.
+ */
+struct HostAddress
+{
+    std::string host;
+    uint16_t port;
+};
+
+/**
+ * @brief Transport over TCP connections between all pairs of hosts. Frames are prefixed by their size,
+ * Nagle's algorithm is disabled since frames are batched by DistributedGraph.
+ * Every host must create its transport with the same list of addresses, the constructor waits
+ * until all hosts are connected.
+ */
+class TcpTransport : public ITransport
+{
+public:
+    /**
+     * @brief Listens on the address of this host and connects to the other hosts.
+     * @param rank_ index of this host in hosts.
+     * @param hosts addresses of all hosts.
+     * @param timeout how long the hosts are waited for.
+     * @param maxFrameSize_ size of the largest frame which is received, the connection sending a larger one is closed.
+     * @throws std::runtime_error if a connection fails or a host is not connected in time.
+     */
+    TcpTransport(size_t rank_, std::vector<HostAddress> hosts, std::chrono::milliseconds timeout = std::chrono::seconds(30),
+                 size_t maxFrameSize_ = size_t{1} << 30);
+    ~TcpTransport() override;
+
+    size_t getRank() const override
+    {return rank;}
+
+    size_t getHostsCount() const override
+    {return connections.size();}
+
+    void send(size_t host, std::vector<std::byte> frame) override;
+
+private:
+    struct Connection
+    {
+        int socket = -1;
+        std::mutex sendMutex;
+        std::thread receiveThread;
+    };
+
+    static void writeAll(int socket, const void *data, size_t size);
+    static bool readAll(int socket, void *data, size_t size);
+    void receiveFunction(size_t host);
+
+    size_t rank;
+    size_t maxFrameSize;
+    std::vector<std::unique_ptr<Connection>> connections;
+};
+
+
+
+inline void ITransport::setReceiver(TReceiver receiver_)
+{
+    std::lock_guard lock(receiverMutex);
+    receiver = std::move(receiver_);
+    if(!receiver)
+        return;
+    for(auto &[host, frame] : earlyFrames)
+        receiver(host, std::move(frame));
+    earlyFrames.clear();
+}
+
+inline void ITransport::deliver(size_t host, std::vector<std::byte> frame)
+{
+    // the lock keeps the order of frames if the receiver is being set
+    std::lock_guard lock(receiverMutex);
+    if(receiver)
+        receiver(host, std::move(frame));
+    else
+        earlyFrames.emplace_back(host, std::move(frame));
+}
+
+
+inline LoopbackNetwork::LoopbackNetwork(size_t hostsCount)
+{
+    for(size_t rank = 0; rank < hostsCount; ++rank)
+        transports.emplace_back(new LoopbackTransport(*this, rank));
+}
+
+inline LoopbackNetwork::~LoopbackNetwork()
+{
+    // stopped before any of them is destroyed, they send to each other
+    for(auto &transport : transports)
+    {
+        std::lock_guard lock(transport->framesMutex);
+        transport->running = false;
+        transport->framesCondition.notify_one();
+    }
+    for(auto &transport : transports)
+        transport->deliveryThread.join();
+}
+
+inline LoopbackNetwork::LoopbackTransport::LoopbackTransport(LoopbackNetwork &network_, size_t rank_):
+    network(network_),
+    rank(rank_),
+    deliveryThread(&LoopbackTransport::deliveryFunction, this)
+{}
+
+inline LoopbackNetwork::LoopbackTransport::~LoopbackTransport()
+{
+    if(deliveryThread.joinable())
+    {
+        {
+            std::lock_guard lock(framesMutex);
+            running = false;
+        }
+        framesCondition.notify_one();
+        deliveryThread.join();
+    }
+}
+
+inline void LoopbackNetwork::LoopbackTransport::send(size_t host, std::vector<std::byte> frame)
+{
+    network.transports[host]->push(rank, std::move(frame));
+}
+
+inline void LoopbackNetwork::LoopbackTransport::push(size_t from, std::vector<std::byte> frame)
+{
+    {
+        std::lock_guard lock(framesMutex);
+        frames.emplace_back(from, std::move(frame));
+    }
+    framesCondition.notify_one();
+}
+
+inline void LoopbackNetwork::LoopbackTransport::deliveryFunction()
+{
+    std::unique_lock lock(framesMutex);
+    for(;;)
+    {
+        framesCondition.wait(lock, [this]{return !running || !frames.empty();});
+        if(frames.empty())
+            return;
+        auto [from, frame] = std::move(frames.front());
+        frames.pop_front();
+        lock.unlock();
+        deliver(from, std::move(frame));
+        lock.lock();
+    }
+}
+
+
+inline TcpTransport::TcpTransport(size_t rank_, std::vector<HostAddress> hosts, std::chrono::milliseconds timeout,
+                                  size_t maxFrameSize_):
+    rank(rank_),
+    maxFrameSize(maxFrameSize_)
+{
+    if(rank >= hosts.size())
+        throw std::runtime_error("Bad rank of the host");
+    for(size_t host = 0; host < hosts.size(); ++host)
+        connections.emplace_back(new Connection);
+
+    auto closeAll = [this]{
+        for(auto &connection : connections)
+            if(connection->socket >= 0)
+                ::close(connection->socket);
+    };
+    auto configure = [](int socket){
+        int yes = 1;
+        ::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    };
+    auto resolve = [](const HostAddress &address){
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *info = nullptr;
+        if(::getaddrinfo(address.host.c_str(), std::to_string(address.port).c_str(), &hints, &info) != 0 || !info)
+            throw std::runtime_error("Can not resolve " + address.host);
+        sockaddr_in result;
+        std::memcpy(&result, info->ai_addr, sizeof(result));
+        ::freeaddrinfo(info);
+        return result;
+    };
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    // the host connects to the hosts with lower ranks and accepts the others, which send their ranks
+    int listener = -1;
+    try
+    {
+        if(rank + 1 < hosts.size())
+        {
+            listener = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if(listener < 0)
+                throw std::runtime_error("Can not create socket");
+            int yes = 1;
+            ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+            sockaddr_in address = resolve(hosts[rank]);
+            if(::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+               ::listen(listener, static_cast<int>(hosts.size())) != 0)
+                throw std::runtime_error("Can not listen on port " + std::to_string(hosts[rank].port));
+        }
+
+        for(size_t host = 0; host < rank; ++host)
+        {
+            sockaddr_in address = resolve(hosts[host]);
+            for(;;)
+            {
+                int socket = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if(socket < 0)
+                    throw std::runtime_error("Can not create socket");
+                if(::connect(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+                {
+                    connections[host]->socket = socket;
+                    break;
+                }
+                ::close(socket);
+                // the host may not listen yet
+                if(std::chrono::steady_clock::now() > deadline)
+                    throw std::runtime_error("Can not connect to " + hosts[host].host);
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            configure(connections[host]->socket);
+            uint32_t ownRank = static_cast<uint32_t>(rank);
+            writeAll(connections[host]->socket, &ownRank, sizeof(ownRank));
+        }
+
+        for(size_t accepted = rank + 1; accepted < hosts.size(); ++accepted)
+        {
+            // zero timeout would wait forever
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            int64_t leftCount = std::max<int64_t>(left.count(), 1);
+            timeval wait{static_cast<time_t>(leftCount / 1000), static_cast<suseconds_t>(leftCount % 1000 * 1000)};
+            ::setsockopt(listener, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait));
+            int socket = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if(socket < 0)
+                throw std::runtime_error("Hosts are not connected in time");
+            uint32_t peerRank = 0;
+            if(!readAll(socket, &peerRank, sizeof(peerRank)) || peerRank <= rank || peerRank >= hosts.size() ||
+               connections[peerRank]->socket >= 0)
+            {
+                ::close(socket);
+                throw std::runtime_error("Bad host connected");
+            }
+            configure(socket);
+            connections[peerRank]->socket = socket;
+        }
+    }
+    catch(...)
+    {
+        if(listener >= 0)
+            ::close(listener);
+        closeAll();
+        throw;
+    }
+    if(listener >= 0)
+        ::close(listener);
+
+    for(size_t host = 0; host < connections.size(); ++host)
+        if(host != rank)
+            connections[host]->receiveThread = std::thread(&TcpTransport::receiveFunction, this, host);
+}
+
+inline TcpTransport::~TcpTransport()
+{
+    for(auto &connection : connections)
+        if(connection->socket >= 0)
+            ::shutdown(connection->socket, SHUT_RDWR);
+    for(auto &connection : connections)
+    {
+        if(connection->receiveThread.joinable())
+            connection->receiveThread.join();
+        if(connection->socket >= 0)
+            ::close(connection->socket);
+    }
+}
+
+inline void TcpTransport::send(size_t host, std::vector<std::byte> frame)
+{
+    Connection &connection = *connections[host];
+    uint64_t size = frame.size();
+    std::lock_guard lock(connection.sendMutex);
+    writeAll(connection.socket, &size, sizeof(size));
+    writeAll(connection.socket, frame.data(), frame.size());
+}
+
+inline void TcpTransport::writeAll(int socket, const void *data, size_t size)
+{
+    auto bytes = static_cast<const char*>(data);
+    while(size > 0)
+    {
+        ssize_t written = ::send(socket, bytes, size, MSG_NOSIGNAL);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+            throw std::runtime_error("Connection to the host is lost");
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+inline bool TcpTransport::readAll(int socket, void *data, size_t size)
+{
+    auto bytes = static_cast<char*>(data);
+    while(size > 0)
+    {
+        ssize_t received = ::recv(socket, bytes, size, 0);
+        if(received < 0 && errno == EINTR)
+            continue;
+        if(received <= 0)
+            return false;
+        bytes += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+inline void TcpTransport::receiveFunction(size_t host)
+{
+    int socket = connections[host]->socket;
+    for(;;)
+    {
+        uint64_t size = 0;
+        if(!readAll(socket, &size, sizeof(size)))
+            return;
+        // a corrupted size would fail the allocation, so the connection is shut down instead (closed by the destructor)
+        if(size > maxFrameSize)
+        {
+            ::shutdown(socket, SHUT_RDWR);
+            return;
+        }
+        std::vector<std::byte> frame(size);
+        if(!readAll(socket, frame.data(), size))
+            return;
+        deliver(host, std::move(frame));
+    }
+}
+
+
+#endif //COMPUTATIONALGRAPH_TRANSPORT_HPP
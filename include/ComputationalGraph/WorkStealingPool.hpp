@@ -0,0 +1,394 @@
+#ifndef COMPUTATIONALGRAPH_WORKSTEALINGPOOL_HPP
+#define COMPUTATIONALGRAPH_WORKSTEALINGPOOL_HPP
+
+#include <thread>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <ComputationalGraph/ChaseLevDeque.hpp>
+#include <ComputationalGraph/EventCount.hpp>
+#include <ComputationalGraph/Profiler.hpp>
+#include <ComputationalGraph/Topology.hpp>
+
+
+/**
+ * @brief Pool of threads with a work stealing deque per worker.
+ * Jobs submitted from a worker are pushed to its own deque, other jobs go to the injection queue of their domain or to the shared one.
+ * Idle workers steal from the other workers' deques, spin for a while and then sleep until a job is submitted.
+ * Workers may be pinned to the CPUs of NUMA domains (see CpuTopology): then they steal from the workers
+ * of their own domain first, and jobs may be submitted to the domain with submitTo.
+ */
+class WorkStealingPool
+{
+public:
+    /**
+     * @brief Creates pool and starts its threads.
+     * @param threadsCount count of workers.
+     * @param spinCount_ how many times an idle worker looks for a job before sleeping.
+     */
+    explicit WorkStealingPool(int threadsCount, size_t spinCount_ = 256);
+
+    /**
+     * @brief Creates pool with workers placed on the NUMA domains.
+     * @param threadsCount count of workers.
+     * @param pinning_ how the workers are pinned, with None all workers are in one domain.
+     * @param topology_ the domains, workers fill them one after another (see CpuTopology::placeWorker).
+     * @param spinCount_ how many times an idle worker looks for a job before sleeping.
+     */
+    WorkStealingPool(int threadsCount, ThreadPinning pinning_, const CpuTopology &topology_ = CpuTopology::detect(),
+                     size_t spinCount_ = 256);
+    ~WorkStealingPool();
+
+    template <class JT>
+    void submit(JT &&job);
+
+    /**
+     * @brief Submits job which is preferably run by a worker of the domain.
+     * Workers of other domains take it only when they have nothing else to do.
+     * @param domain index of the domain, CpuTopology::anyDomain is the same as submit.
+     * @param job the job.
+     */
+    template <class JT>
+    void submitTo(size_t domain, JT &&job);
+
+    size_t domainsCount() const
+    {return domainWorkers.size();}
+
+    /**
+     * @brief Returns the domain of the calling worker, CpuTopology::anyDomain for other threads.
+     */
+    size_t currentDomain() const
+    {return currentPool == this ? workerDomains[currentIndex] : CpuTopology::anyDomain;}
+
+    /**
+     * @brief Returns approximate count of queued jobs.
+     */
+    size_t size() const;
+
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    /**
+     * @brief Returns counters of every worker, available if COMPUTATIONALGRAPH_PROFILING is defined.
+     */
+    std::vector<WorkerStats> getWorkerStats() const;
+#endif
+
+private:
+    /**
+     * @brief Type erased job. Small trivially copyable jobs (like graph nodes' tasks) are stored inline,
+     * other jobs are moved to the heap.
+     */
+    struct Task
+    {
+        void (*invoke)(Task &task) = nullptr;
+        void (*destroy)(Task &task) = nullptr;
+        alignas(uintptr_t) unsigned char storage[2 * sizeof(uintptr_t)];
+    };
+
+    template <class JT>
+    static Task makeTask(JT &&job);
+
+    struct InjectionQueue
+    {
+        std::deque<Task> tasks;
+        std::mutex mutex;
+    };
+
+    void threadFunction(size_t index);
+    std::optional<Task> findTask(size_t index, std::minstd_rand &random);
+    std::optional<Task> popInjected(InjectionQueue &queue);
+    std::optional<Task> stealFrom(size_t index, const std::vector<size_t> &victims, std::minstd_rand &random);
+    void push(const Task &task, size_t domain);
+    void wake(size_t domain);
+    bool hasWork() const;
+
+    std::vector<std::unique_ptr<ChaseLevDeque<Task>>> deques;
+    // queue of every domain and the shared one (the last), injectedCount counts the jobs in all of them
+    std::vector<std::unique_ptr<InjectionQueue>> injectionQueues;
+    std::atomic<size_t> injectedCount;
+
+    size_t spinCount;
+    ThreadPinning pinning;
+    CpuTopology topology;
+    std::vector<size_t> workerDomains;
+    std::vector<std::vector<size_t>> domainWorkers;
+    // idle workers sleep on the event of their domain
+    std::unique_ptr<EventCount[]> idleWorkers;
+
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    std::unique_ptr<WorkerCounters[]> workerCounters;
+#endif
+
+    std::vector<std::thread> threads;
+    std::atomic<bool> running;
+
+    inline static thread_local WorkStealingPool *currentPool = nullptr;
+    inline static thread_local size_t currentIndex = 0;
+};
+
+
+inline WorkStealingPool::WorkStealingPool(int threadsCount, size_t spinCount_):
+    WorkStealingPool(threadsCount, ThreadPinning::None, CpuTopology{}, spinCount_)
+{}
+
+inline WorkStealingPool::WorkStealingPool(int threadsCount, ThreadPinning pinning_, const CpuTopology &topology_,
+                                          size_t spinCount_):
+    injectedCount(0),
+    spinCount(spinCount_),
+    pinning(pinning_),
+    topology(topology_),
+#ifdef COMPUTATIONALGRAPH_PROFILING
+    workerCounters(new WorkerCounters[threadsCount]),
+#endif
+    running(true)
+{
+    // unpinned workers may run anywhere, so the domains mean nothing
+    size_t domainsCount = pinning == ThreadPinning::None || topology.domains.empty() ? 1 : topology.domainsCount();
+    domainWorkers.resize(domainsCount);
+    for(int i = 0; i < threadsCount; ++i)
+    {
+        size_t domain = domainsCount == 1 ? 0 : topology.placeWorker(i).second;
+        workerDomains.push_back(domain);
+        domainWorkers[domain].push_back(i);
+    }
+    for(size_t i = 0; i <= domainsCount; ++i)
+        injectionQueues.emplace_back(new InjectionQueue);
+    idleWorkers.reset(new EventCount[domainsCount]);
+
+    for(int i = 0; i < threadsCount; ++i)
+        deques.emplace_back(new ChaseLevDeque<Task>);
+    for(int i = 0; i < threadsCount; ++i)
+        threads.emplace_back(&WorkStealingPool::threadFunction, this, i);
+}
+
+inline WorkStealingPool::~WorkStealingPool()
+{
+    running = false;
+    for(size_t domain = 0; domain < domainsCount(); ++domain)
+        idleWorkers[domain].notifyAll();
+    for(auto &t : threads)
+        t.join();
+
+    // jobs which were not run still own their heap state
+    auto destroy = [](Task &task){
+        if(task.destroy)
+            task.destroy(task);
+    };
+    for(auto &deque : deques)
+        while(auto task = deque->take())
+            destroy(*task);
+    for(auto &queue : injectionQueues)
+        for(auto &task : queue->tasks)
+            destroy(task);
+}
+
+template <class JT>
+WorkStealingPool::Task WorkStealingPool::makeTask(JT &&job)
+{
+    using TJob = std::decay_t<JT>;
+    Task task;
+    if constexpr(std::is_trivially_copyable_v<TJob> && sizeof(TJob) <= sizeof(Task::storage) && alignof(TJob) <= alignof(Task))
+    {
+        new (task.storage) TJob(std::forward<JT>(job));
+        task.invoke = [](Task &t){(*std::launder(reinterpret_cast<TJob*>(t.storage)))();};
+    }
+    else
+    {
+        auto *boxed = new TJob(std::forward<JT>(job));
+        std::memcpy(task.storage, &boxed, sizeof(boxed));
+        task.invoke = [](Task &t){
+            TJob *j;
+            std::memcpy(&j, t.storage, sizeof(j));
+            (*j)();
+            delete j;
+        };
+        task.destroy = [](Task &t){
+            TJob *j;
+            std::memcpy(&j, t.storage, sizeof(j));
+            delete j;
+        };
+    }
+    return task;
+}
+
+template <class JT>
+void WorkStealingPool::submit(JT &&job)
+{
+    push(makeTask(std::forward<JT>(job)), CpuTopology::anyDomain);
+}
+
+template <class JT>
+void WorkStealingPool::submitTo(size_t domain, JT &&job)
+{
+    push(makeTask(std::forward<JT>(job)), domain < domainsCount() ? domain : CpuTopology::anyDomain);
+}
+
+inline void WorkStealingPool::push(const Task &task, size_t domain)
+{
+    bool fromWorker = currentPool == this;
+    if(fromWorker && (domain == CpuTopology::anyDomain || domain == workerDomains[currentIndex]))
+    {
+        deques[currentIndex]->push(task);
+        domain = workerDomains[currentIndex];
+    }
+    else
+    {
+        InjectionQueue &queue = *injectionQueues[domain == CpuTopology::anyDomain ? domainsCount() : domain];
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(task);
+        ++injectedCount;
+    }
+
+    wake(domain != CpuTopology::anyDomain ? domain : 0);
+}
+
+inline void WorkStealingPool::wake(size_t domain)
+{
+    // the other domains are woken only if the preferred one has no idle workers
+    if(idleWorkers[domain].notifyOne())
+        return;
+    for(size_t i = 1; i < domainsCount(); ++i)
+        if(idleWorkers[(domain + i) % domainsCount()].notifyOne())
+            return;
+}
+
+inline bool WorkStealingPool::hasWork() const
+{
+    if(injectedCount > 0)
+        return true;
+    for(const auto &deque : deques)
+        if(!deque->empty())
+            return true;
+    return false;
+}
+
+inline std::optional<WorkStealingPool::Task> WorkStealingPool::popInjected(InjectionQueue &queue)
+{
+    std::lock_guard lock(queue.mutex);
+    if(queue.tasks.empty())
+        return {};
+    Task task = queue.tasks.front();
+    queue.tasks.pop_front();
+    --injectedCount;
+    return task;
+}
+
+inline std::optional<WorkStealingPool::Task> WorkStealingPool::stealFrom(size_t index, const std::vector<size_t> &victims,
+                                                                        std::minstd_rand &random)
+{
+    // start from a random victim, so thieves do not all attack the same worker
+    size_t count = victims.size();
+    size_t start = random() % count;
+    for(size_t i = 0; i < count; ++i)
+    {
+        size_t victim = victims[(start + i) % count];
+        if(victim == index)
+            continue;
+        if(auto task = deques[victim]->steal())
+        {
+#ifdef COMPUTATIONALGRAPH_PROFILING
+            workerCounters[index].count(workerCounters[index].stealsCount);
+#endif
+            return task;
+        }
+    }
+    return {};
+}
+
+inline std::optional<WorkStealingPool::Task> WorkStealingPool::findTask(size_t index, std::minstd_rand &random)
+{
+    if(auto task = deques[index]->take())
+        return task;
+
+    // local work first: the queue of the domain, the shared queue, the deques of the domain
+    size_t domain = workerDomains[index];
+    if(injectedCount > 0)
+    {
+        if(auto task = popInjected(*injectionQueues[domain]))
+            return task;
+        if(auto task = popInjected(*injectionQueues[domainsCount()]))
+            return task;
+    }
+    if(auto task = stealFrom(index, domainWorkers[domain], random))
+        return task;
+
+    for(size_t i = 1; i < domainsCount(); ++i)
+    {
+        size_t other = (domain + i) % domainsCount();
+        if(injectedCount > 0)
+            if(auto task = popInjected(*injectionQueues[other]))
+                return task;
+        if(auto task = stealFrom(index, domainWorkers[other], random))
+            return task;
+    }
+    return {};
+}
+
+inline void WorkStealingPool::threadFunction(size_t index)
+{
+    currentPool = this;
+    currentIndex = index;
+    if(pinning != ThreadPinning::None)
+        pinWorker(topology, index, pinning);
+    EventCount &idle = idleWorkers[workerDomains[index]];
+    std::minstd_rand random(static_cast<unsigned>(index) + 1);
+
+    bool wokenUp = false;
+    while(running)
+    {
+        if(auto task = findTask(index, random))
+        {
+            // wake ups are not repeated while this worker was waking up, so it passes the rest further
+            if(wokenUp && hasWork())
+                wake(workerDomains[index]);
+            wokenUp = false;
+#ifdef COMPUTATIONALGRAPH_PROFILING
+            workerCounters[index].count(workerCounters[index].jobsCount);
+#endif
+            task->invoke(*task);
+            continue;
+        }
+
+        bool found = false;
+        for(size_t i = 0; i < spinCount && !found; ++i)
+        {
+            cpuRelax();
+            found = hasWork();
+        }
+        if(found)
+            continue;
+
+        uint32_t key = idle.prepareWait();
+        if(!running || hasWork())
+            idle.cancelWait();
+        else
+        {
+#ifdef COMPUTATIONALGRAPH_PROFILING
+            workerCounters[index].count(workerCounters[index].idleCount);
+#endif
+            idle.wait(key);
+            wokenUp = true;
+        }
+    }
+}
+
+inline size_t WorkStealingPool::size() const
+{
+    size_t count = injectedCount;
+    for(const auto &deque : deques)
+        count += deque->size();
+    return count;
+}
+
+
+#ifdef COMPUTATIONALGRAPH_PROFILING
+inline std::vector<WorkerStats> WorkStealingPool::getWorkerStats() const
+{
+    std::vector<WorkerStats> stats;
+    for(size_t i = 0; i < threads.size(); ++i)
+        stats.push_back(workerCounters[i].load());
+    return stats;
+}
+#endif
+
+
+#endif //COMPUTATIONALGRAPH_WORKSTEALINGPOOL_HPP